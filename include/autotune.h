@@ -0,0 +1,35 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+// How mining threads are pinned to CPUs
+typedef enum {
+    AFFINITY_NONE = 0,  // Left to the scheduler
+    AFFINITY_COMPACT,   // Thread i on the i-th CPU, SMT siblings filled together
+    AFFINITY_SPREAD     // One thread per physical core before any SMT sibling
+} AffinityLayout;
+
+// Measured best settings for the mining threads on this host
+typedef struct {
+    int threads;              // Mining threads for thread = -1
+    int batch;                // Hashes between job checks
+    AffinityLayout affinity;
+    bool device;              // Run the compute backend's device thread next to them
+    double hash_rate;         // Total H/s of the winning trial
+} TuneProfile;
+
+// Load the profile cached for this CPU model, CPU count and build from
+// cache_path, or benchmark the CPU hashing loop (a few seconds, before the pool
+// starts filling) and append the result to the cache. With backend set, the
+// compute backend's dispatches are timed next to the CPU threads too and
+// device says whether they add to the total.
+bool autotune(const char* cache_path, bool backend, TuneProfile* profile);
+
+// Pin the index-th mining thread according to layout
+void pin_mining_thread(pthread_t thread, AffinityLayout layout, int index);
+
+const char* affinity_name(AffinityLayout layout);
+
+#endif // AUTOTUNE_H
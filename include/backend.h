@@ -0,0 +1,41 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "miner.h"
+
+// A compute backend hashes pool candidates for a job in bulk. The pool is
+// uploaded incrementally as it is published; a search covers pool indices
+// [start, start + count) modulo pool_size and reports only the indices whose
+// hash meets the job difficulty. Hits are re-checked on the CPU before submit.
+typedef struct ComputeBackend ComputeBackend;
+
+struct ComputeBackend {
+    const char* name;
+
+    // Make keypairs[start .. start + count) available to the backend
+    bool (*upload)(ComputeBackend* backend, const Keypair* keypairs, size_t start, size_t count);
+
+    // Hash `count` candidates from `start`. Writes up to max_hits pool indices
+    // to hits and the total number of hits (possibly more) to hit_count.
+    bool (*search)(ComputeBackend* backend, const Job* job, size_t pool_size, size_t start,
+                   size_t count, uint32_t* hits, size_t max_hits, size_t* hit_count);
+
+    void (*destroy)(ComputeBackend* backend);
+
+    void* impl;
+};
+
+// Reference implementation on the calling thread, used to check other backends
+ComputeBackend* create_cpu_backend(void);
+
+// OpenCL backend for the "platform:device" index pair (e.g. "0:0"). Returns
+// NULL if OpenCL is unavailable or the binary was built without OPENCL=1.
+ComputeBackend* create_opencl_backend(const char* device, size_t capacity);
+
+// Compare a backend against the CPU reference on synthetic candidates
+bool backend_self_test(ComputeBackend* backend, size_t capacity);
+
+#endif // BACKEND_H
@@ -0,0 +1,24 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include "miner.h"
+
+// A deterministic pool (pool_seed or a coordinator range) holds the same keys
+// after a restart, so the pool cursor reached on a seed says which candidates
+// were already tried against it. The checkpoint file keeps that position per
+// seed, one line each, most recent first:
+//   <base_key_hex> <capacity> <position> <hashed> <seed>
+// A job whose seed is in the file resumes at its position once the pool is
+// full. Random pools are not tracked.
+
+// Load path and save to it every interval seconds (only on shutdown if 0)
+bool start_checkpoints(const char* path, int interval);
+
+// The job published for seed replaced the previous one
+void checkpoint_job_started(const char* seed);
+
+// Write the file now, e.g. before exiting
+void save_checkpoint(void);
+
+#endif // CHECKPOINT_H
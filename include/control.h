@@ -0,0 +1,17 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Local control socket. Clients send one command per line and get one reply
+// line back for each, e.g.
+//   reload        re-read cminer.conf and apply it
+//   threads <n>   resize the mining thread set (-1 for one per CPU, 0 only with a device)
+//   status        current threads, server and intervals
+typedef void (*ControlHandler)(void* ctx, const char* command, char* reply, size_t reply_size);
+
+// Serve commands on listen_addr ("host:port" or "unix:/path"), empty to disable
+bool start_control_server(const char* listen_addr, ControlHandler handler, void* ctx);
+
+#endif // CONTROL_H
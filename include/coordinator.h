@@ -0,0 +1,41 @@
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <stdbool.h>
+#include "miner.h"
+
+// One coordinator polls the pool server and hands every worker a disjoint
+// keyspace range (base private key + count) for its keypair pool. Workers
+// take jobs from the coordinator instead of the pool server and relay their
+// solutions through it.
+//
+// Line protocol, one '\n' terminated message per line:
+//   worker -> coordinator
+//     HELLO <name> <capacity> [<base_hex>]   on connect, a base asks to keep a range this
+//                                             coordinator assigned; one it doesn't know or
+//                                             another worker holds is answered with a new RANGE
+//     RATE <total_hashes>                     every few seconds
+//     SOLVED <private_key_hex> <hash_hex>     candidate meeting the current job
+//   coordinator -> worker
+//     RANGE <base_hex> <count>                keyspace range for the worker's pool
+//     JOB <diff_hex> <reward> <last_found> <seed>
+//     RESULT <accepted|rejected|stale> <hash_hex>
+
+typedef struct {
+    // Worker: a new job from the coordinator, job is only valid during the call
+    void (*on_job)(void* ctx, Job* job);
+    // Coordinator: a verified solution from a worker, returns true if the pool accepted it
+    bool (*on_solution)(void* ctx, Solution* solution);
+    void* ctx;
+} CoordinatorHandlers;
+
+// Coordinator side. Also starts the local pool on the first range.
+bool start_coordinator(const MinerConfig* config, const CoordinatorHandlers* handlers);
+void coordinator_publish_job(const Job* job);
+void coordinator_stats(int* workers, double* hashrate);
+
+// Worker side. The local pool starts once the coordinator assigns a range.
+bool start_coordinator_worker(const MinerConfig* config, const CoordinatorHandlers* handlers);
+bool coordinator_relay_solution(const Solution* solution);
+
+#endif // COORDINATOR_H
@@ -0,0 +1,26 @@
+#ifndef JOBLOG_H
+#define JOBLOG_H
+
+#include <stdbool.h>
+#include "miner.h"
+
+// Work accounting, one CSV line per job, appended when the job is replaced:
+//   start,seconds,hashes,candidates,hash_rate,expected_hashes,found,reward,best_hash,diff,node,seed
+// candidates are the distinct keys among the hashes: a pool that isn't
+// refreshed holds only as many keys per seed as have been published, and
+// hashing past that repeats them. expected_hashes is 2^256 / (diff + 1) rounded down, the mean number of
+// candidates per solution. found counts distinct solutions. The seed is last
+// and never quoted. tools/jobstats summarizes these files.
+
+bool job_log_open(const char* path, const char* node);
+
+// new_job replaces the current job, which reached best_hash
+void job_log_switch(const Job* new_job, const uint8_t best_hash[32]);
+
+// A solution found by this miner's threads on the current job
+void job_log_solution(const Solution* solution);
+
+// Write the record of the current job, before exiting
+void job_log_close(void);
+
+#endif // JOBLOG_H
@@ -0,0 +1,26 @@
+#ifndef KEYSET_H
+#define KEYSET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Growable set of 32-byte keys (private keys, hashes) for remembering what
+// was already seen. Not thread safe, callers hold their own lock.
+typedef struct {
+    uint8_t (*keys)[32];
+    bool* used;
+    size_t count;
+    size_t capacity;   // Power of two, 0 until the first insert
+} KeySet;
+
+// True if key was not in the set yet. Also true when the set cannot grow, so
+// a caller never drops something only because memory ran out.
+bool keyset_insert(KeySet* set, const uint8_t key[32]);
+
+// Empty the set, keeping its memory
+void keyset_clear(KeySet* set);
+
+void keyset_free(KeySet* set);
+
+#endif // KEYSET_H
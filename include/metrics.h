@@ -0,0 +1,71 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "miner.h"
+
+#define METRICS_HISTOGRAM_BUCKETS 10
+
+// Per-thread counter padded to a cache line so mining threads don't false-share
+typedef struct {
+    _Atomic uint64_t value;
+    char pad[64 - sizeof(uint64_t)];
+} MetricsCounter;
+
+// Fixed-bucket latency histogram (bucket bounds live in metrics.c)
+typedef struct {
+    _Atomic uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t count;
+} MetricsHistogram;
+
+// All exported miner internals. Writers only ever touch atomics, the
+// exporter thread reads them without locks.
+typedef struct {
+    MetricsCounter hashes[MAX_THREADS];   // Hashes done per mining thread
+    _Atomic int thread_count;             // Counter slots in use, never shrinks
+    _Atomic int active_threads;           // Mining threads running now, plus the device thread
+
+    _Atomic uint64_t job_seq;             // Bumped on every new job
+    _Atomic uint64_t job_published_ns;    // Monotonic time the job was published
+    _Atomic uint64_t job_hash_base;       // Total hashes at the time of publishing
+    MetricsHistogram job_switch_latency;  // Publish -> first hash on the new job, per thread
+
+    MetricsHistogram submit_latency;
+    _Atomic uint64_t submits_accepted;
+    _Atomic uint64_t submits_rejected;
+    _Atomic uint64_t submits_failed;
+
+    _Atomic uint64_t job_fetch_failures;
+    _Atomic uint64_t curl_errors;
+    _Atomic uint64_t report_failures;
+} MinerMetrics;
+
+extern MinerMetrics g_metrics;
+
+static inline uint64_t metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline void metrics_add_hashes(int thread_id, uint64_t count) {
+    atomic_fetch_add_explicit(&g_metrics.hashes[thread_id].value, count, memory_order_relaxed);
+}
+
+static inline void metrics_inc(_Atomic uint64_t* counter) {
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+void metrics_observe_submit(uint64_t elapsed_ns);
+void metrics_observe_job_switch(uint64_t elapsed_ns);
+void metrics_job_published(void);
+uint64_t metrics_total_hashes(void);
+
+// Start the exporter thread. listen_addr is "host:port" or "unix:/path".
+bool start_metrics_server(const char* listen_addr);
+
+#endif // METRICS_H
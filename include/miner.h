@@ -3,8 +3,11 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <sys/stat.h>
 #include <pthread.h>
+#include <secp256k1.h>
+#include "sha256.h"
 
 // Color definitions
 #define ANSI_COLOR_RED     "\x1b[31m"
@@ -15,28 +18,111 @@
 #define ANSI_COLOR_CYAN    "\x1b[36m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
+#define MAX_THREADS 384
+
 // Global variables for thread safety
 extern uint8_t* g_best_hash;
 extern pthread_mutex_t g_hash_mutex;
 
 // Keypair structure
 typedef struct {
+    uint32_t midstate[8];    // SHA-256 state after the first 128 hex chars of the public key
     uint8_t public_key[65];  // Uncompressed public key
     uint8_t private_key[32]; // Private key
 } Keypair;
 
-// Keypair pool structure
+// How the keypair pool memory is obtained
+typedef enum {
+    POOL_BACKING_HEAP = 0,   // malloc
+    POOL_BACKING_MMAP,       // Anonymous mapping
+    POOL_BACKING_HUGEPAGES,  // MAP_HUGETLB, falling back to transparent huge pages
+    POOL_BACKING_SHM         // POSIX shared memory, one pool for every process on the host
+} PoolBacking;
+
+// What the keys of a shared pool are, declared by the process generating them
+typedef enum {
+    SHARED_KEYS_PENDING = 0,       // Owner doesn't know its key source yet
+    SHARED_KEYS_RANDOM,
+    SHARED_KEYS_RANGE              // base_key + i, from pool_seed or a coordinator
+} SharedPoolKeys;
+
+// Header page of a shared pool segment, followed by the keypairs and one
+// refresh generation per batch. One process at a time owns the segment and
+// generates into it: the owner holds an flock on it, so the kernel drops the
+// ownership when the owner dies and another process can take the fill over.
+// The others map the keypairs read-only and share the published size and the
+// mining cursor.
+typedef struct {
+    _Atomic uint32_t magic;        // SHARED_POOL_MAGIC once the header is valid
+    uint32_t keypair_size;         // sizeof(Keypair) of the creator
+    size_t capacity;
+    _Atomic size_t size;           // Published prefix, written by the owner only
+    _Atomic size_t cursor;         // Mining cursor shared by every attached process
+    _Atomic int32_t owner_pid;     // Last process to own the segment, for messages
+    _Atomic uint32_t keys;         // SharedPoolKeys, set before anything is published
+    uint8_t base_key[32];          // First key for SHARED_KEYS_RANGE
+    _Atomic uint64_t refreshed_batches;
+} SharedPoolHeader;
+
+#define SHARED_POOL_MAGIC 0x434d5032  // "CMP2"
+#define SHARED_POOL_HEADER_SIZE 4096
+
+// Pool indices a mining thread claims from the shared cursor at once
+#define KEYPAIR_CLAIM_SIZE 256
+
+// Keypairs generated, published and refreshed at a time. Small enough that
+// the first batch (and so the first hash) is ready well under a second after
+// startup.
+#define GEN_BATCH_SIZE 256
+
+// Outcome of hashing one candidate
+typedef enum {
+    MINE_MISS = 0,                 // Hashed, no solution
+    MINE_SOLVED,                   // Hashed and solution filled in
+    MINE_STARVED                   // Nothing hashed, every published keypair is claimed
+} MineResult;
+
+// Keypair pool structure. Generator threads fill it in batches in the
+// background; mining can start as soon as the first batch is published.
 typedef struct {
     Keypair* keypairs;
-    size_t size;
+    _Atomic size_t* size;          // Contiguous prefix of generated keypairs
     size_t capacity;
-    size_t current_index;
-    pthread_mutex_t mutex;
+    PoolBacking backing;
+    size_t mapped_bytes;           // Length of the mapping for mmap backings
+    _Atomic size_t* current_index; // Mining cursor, claimed in ranges
+    _Atomic size_t local_size;     // Storage behind size/current_index unless shared
+    _Atomic size_t local_index;
+    SharedPoolHeader* shared;      // Segment header for the shm backing
+    int shm_fd;                    // Segment, kept open for the ownership lock
+    bool attached;                 // Mapped a segment another process created
+    bool owner;                    // Generates into the pool (always unless shared)
+    pthread_mutex_t mutex;         // Guards batch publication
+
+    // Background generation
+    size_t batch_count;
+    uint8_t* batch_done;           // Per-batch completion flags for the first fill
+    _Atomic uint32_t* batch_generation; // Bumped each time the refresh rewrites a batch
+    _Atomic uint64_t* refreshed_batches; // Sum of batch_generation
+    _Atomic uint64_t local_refreshed;
+    _Atomic uint32_t epoch;        // Bumped when the pool is rebuilt for another range
+    _Atomic uint32_t claim_epoch;  // Bumped when the cursor is moved, drops the threads' claims
+    size_t batches_published;
+    _Atomic size_t next_batch;     // Next batch for a generator to claim
+    _Atomic bool stop;
+    bool refresh;                  // Keep regenerating entries at low priority once full
+    bool sequential;               // Entry i holds base_key + i instead of a random key
+    uint8_t base_key[32];
+    pthread_t* threads;
+    int thread_count;
+    int wanted_threads;            // Generator threads to start on taking a shared pool over
+    pthread_t standby;             // Waits to take over a shared pool from a dead owner
+    bool standby_running;
 } KeypairPool;
 
 // Configuration structure
 typedef struct {
-    char* server;
+    char* server;            // Comma separated job servers, in order of preference
     char* rewards_dir;
     char* on_mined;
     int thread_count;
@@ -47,14 +133,42 @@ typedef struct {
         char* report_user;
     } reporting;
     char* pool_secret;
+    char* metrics_listen;    // "host:port" or "unix:/path", empty to disable
+    bool pool_refresh;       // Keep replacing pool keypairs in the background
+    size_t pool_memory;      // Keypair pool budget in bytes
+    int generator_threads;   // Keypair generator threads (-1 for auto)
+    PoolBacking pool_backing;
+    char* pool_shm_name;     // Segment name for pool_backing = "shm"
+    char* compute_backend;   // "cpu", or "opencl" for an extra device thread
+    char* opencl_device;     // "platform:device" indices
+    size_t opencl_batch;     // Candidates per OpenCL dispatch
+    char* coordinator_listen; // Coordinator mode: hand out keyspace ranges on this address
+    char* coordinator;        // Worker mode: take jobs and a range from this coordinator
+    char* worker_name;        // Name reported to the coordinator (hostname if empty)
+    char* job_record;         // Append the job stream to this file
+    char* job_replay;         // Take jobs from this recorded stream instead of the server
+    double replay_speed;      // Replay pace relative to the recording
+    char* pool_seed;          // Deterministic pool: keys SHA256(pool_seed) + i
+    char* control_listen;     // Control socket address, empty to disable
+    int server_check_interval; // Seconds between job server health checks
+    bool autotune;            // Benchmark thread count, batch and affinity at startup
+    char* autotune_cache;     // Tuned profiles per CPU model
+    char* checkpoint_file;    // Per-seed progress of a deterministic pool, empty to disable
+    int checkpoint_interval;  // Seconds between checkpoint saves
+    char* job_log;            // Append one accounting line per job to this CSV file
 } MinerConfig;
 
 // Job structure
 typedef struct {
-    char* seed;
+    char seed[MAX_SEED_LEN + 1];
+    size_t seed_len;
     uint8_t diff[32];  // 256-bit difficulty
     double reward;
     uint64_t last_found;
+    uint32_t diff_words[8];   // diff as big-endian words, for word-wise compares
+    uint64_t id;       // Assigned when published, changes with every new job; 0 before the first
+    const char* server;       // URL of the server that issued the job, NULL if none
+    Sha256TailTemplate tail;  // Compiled hash tail for this seed
 } Job;
 
 // Solution structure
@@ -63,26 +177,77 @@ typedef struct {
     uint8_t private_key[32]; // Private key
     char* hash;
     double reward;
+    const char* server;      // Server that issued the job, solutions are submitted there
 } Solution;
 
 // Function declarations
 MinerConfig* load_config(const char* config_file);
 void free_config(MinerConfig* config);
-Job* get_job(const char* server_url);
+// Fetch a job into a caller-owned slot. Fills every field but id and tail.
+bool get_job(const char* server_url, Job* job);
+// Fill the fixed-capacity job fields. Return false if the value doesn't fit.
+bool job_set_seed(Job* job, const char* seed, size_t seed_len);
+bool job_set_diff(Job* job, const char* hex, size_t hex_len);
+// Feed the job parser sample responses split at every chunk boundary
+bool job_parser_self_test(void);
 bool submit_solution(const MinerConfig* config, const Solution* solution);
-bool mine_block(const MinerConfig* config, Job* job, Solution* solution);
+MineResult mine_block(const MinerConfig* config, Job* job, Solution* solution);
+size_t mine_backend_batch(const Job* job, Solution* solutions, size_t max_solutions, uint64_t* hashed);
 void print_hash_rate(uint64_t hash_count);
 void save_reward(const MinerConfig* config, const Solution* solution, uint64_t coin_id);
 bool report_status(const MinerConfig* config, uint64_t hash_count, double total_mined, const uint8_t* best_hash);
 
+// Host CPU information
+int get_available_cpus(void);
+int get_physical_cores(void);
+void get_cpu_model(char* model, size_t size);
+// CPUs in the affinity mask in pinning order: compact keeps SMT siblings
+// together, spread takes one hardware thread of every core first
+int get_cpu_order(int* cpus, int max, bool spread);
+
+// Stream sockets for "host:port" or "unix:/path" addresses
+int open_listener(const char* address);
+int connect_socket(const char* address);
+bool send_all(int fd, const char* buf, size_t len);
+
 // Mining context management
-void init_mining(void);
+void init_mining(const MinerConfig* config);
+void start_mining_pool(const uint8_t* base_key);
+void restart_mining_pool(const uint8_t* base_key);
+size_t mining_pool_capacity(void);
+// Keypairs published so far, the capacity once the pool is full
+size_t mining_pool_size(void);
+// Generators keep replacing keys once full: pool_refresh, and never for a keyspace range
+bool mining_pool_refreshing(void);
+// Base key and capacity of a deterministic pool, which holds the same keys on
+// every start. False for a random pool.
+bool mining_pool_base(uint8_t base_key[32], size_t* capacity);
+size_t mining_pool_cursor(void);
+void set_mining_pool_cursor(size_t cursor);
+// Candidates claimed from the cursor that may not have been hashed yet
+size_t mining_pool_in_flight(void);
+bool mining_ready(void);
+bool mining_backend_enabled(void);
+// Autotune device trials, before the pool fills: keypairs stand in for the
+// first pool entries on the device, and each trial dispatch hashes one
+// configured batch of them. Returns the candidates hashed, 0 on failure.
+bool load_backend_trial(const Keypair* keypairs, size_t count);
+uint64_t mine_backend_trial(const Job* job, size_t start);
+// Drop the compute backend when the CPU threads alone are faster
+void disable_mining_backend(void);
+void reset_best_hash(void);
 void cleanup_mining(void);
 
 // Keypair pool management
-KeypairPool* create_keypair_pool(size_t capacity);
+KeypairPool* create_keypair_pool(size_t capacity, PoolBacking backing, const char* shm_name);
 void free_keypair_pool(KeypairPool* pool);
-void pregenerate_keypairs(KeypairPool* pool, size_t count);
+bool start_keypair_generation(KeypairPool* pool, int thread_count, bool refresh, const uint8_t* base_key);
+bool restart_keypair_generation(KeypairPool* pool, int thread_count, bool refresh, const uint8_t* base_key);
+void stop_keypair_generation(KeypairPool* pool);
+bool generate_keypair(const secp256k1_context* ctx, Keypair* keypair);
+bool generate_keypair_range(const secp256k1_context* ctx, const uint8_t base_key[32], uint64_t first,
+                            Keypair* keypairs, size_t count);
 Keypair* get_next_keypair(KeypairPool* pool);
+void get_keypair_pool_stats(size_t* size, size_t* capacity, size_t* cursor);
 
 #endif // MINER_H 
\ No newline at end of file
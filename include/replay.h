@@ -0,0 +1,23 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "miner.h"
+
+// Job streams are text files, one job per line after a header:
+//   <ms since first job> <diff_hex> <reward> <last_found> <seed>
+
+// Append every job published from now on to path
+bool job_record_open(const char* path);
+void job_record_append(const Job* job);
+
+// Feed the jobs in config->job_replay to publish() at replay_speed times the
+// recorded pace, starting once the pool is full. The job passed to publish()
+// is reused for the next line. Prints a summary and exits after the last job.
+bool start_job_replay(const MinerConfig* config, void (*publish)(void* ctx, Job* job), void* ctx);
+
+// Base private key of the deterministic pool for a seed string
+bool pool_seed_base(const char* seed, uint8_t base_key[32]);
+
+#endif // REPLAY_H
@@ -0,0 +1,40 @@
+#ifndef SERVERS_H
+#define SERVERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "miner.h"
+
+// Job servers come from the comma separated `server` list, in order of
+// preference. A background thread probes each of them; jobs are fetched from
+// the fastest healthy one and fail over down the list as soon as a fetch
+// fails. Every job carries the URL of the server that issued it, and its
+// solutions are submitted there.
+
+#define MAX_JOB_SERVERS 8
+
+typedef struct {
+    const char* url;
+    bool healthy;
+    uint64_t latency_ns;   // Smoothed get-challenge round trip
+    bool current;          // Jobs are being fetched from this one
+} JobServerStatus;
+
+// Replace the server list, keeping the health of servers still on it.
+// Returns the number of servers, 0 if the list was rejected and the old one kept.
+int set_job_servers(const char* list);
+
+// Probe every server each interval seconds
+bool start_server_health_checks(int interval);
+
+// Fetch a job from the best server into job, failing over to the others.
+// Returns false only if every server failed.
+bool fetch_job(Job* job);
+
+// Server jobs are currently fetched from, never NULL once servers are set.
+// The returned URL stays valid for the life of the process.
+const char* current_job_server(void);
+
+int job_server_status(JobServerStatus* status, int max);
+
+#endif // SERVERS_H
@@ -0,0 +1,50 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Every candidate message is hex(public_key) || seed. The first 128 hex chars
+// (two SHA-256 blocks) depend only on the keypair, so the pool stores the
+// chaining state after them ("midstate"). Everything after that is the tail:
+// the last two pubkey hex chars, the seed, padding and length.
+#define SHA256_PREFIX_LEN 128
+#define MAX_SEED_LEN 256
+#define SHA256_MAX_TAIL_BLOCKS ((2 + MAX_SEED_LEN + 9 + 63) / 64)
+
+// Job-specific tail, compiled once per job. Only the top 16 bits of word 0 of
+// the first tail block change between candidates; all later tail blocks are
+// fully constant, so their message schedule is precomputed.
+typedef struct {
+    int blocks;                      // Number of tail blocks (1..SHA256_MAX_TAIL_BLOCKS)
+    uint32_t w0_low;                 // Low 16 bits of word 0 of the first tail block
+    uint32_t kw_first[16];           // K[t] + W[t] for rounds 1..15 of the first tail block
+    uint32_t w_first[16];            // Message words of the first tail block (w[0] without candidate chars)
+    uint32_t w_pre[64];              // Candidate-independent part of W[16..31] of the first tail block
+    uint32_t kw_rest[SHA256_MAX_TAIL_BLOCKS - 1][64];  // K[t] + W[t] for the remaining tail blocks
+} Sha256TailTemplate;
+
+void sha256_init_state(uint32_t state[8]);
+void sha256_transform(uint32_t state[8], const uint8_t block[64]);
+void sha256_state_to_bytes(const uint32_t state[8], uint8_t out[32]);
+
+// Chaining state after hashing the first 128 hex chars of the public key
+void sha256_pubkey_midstate(uint32_t midstate[8], const uint8_t public_key[65]);
+
+// Build the tail template for a job seed. Returns false if the seed is too long.
+bool sha256_build_tail(Sha256TailTemplate* tail, const char* seed, size_t seed_len);
+
+// Finish hash(hex(public_key) || seed) from a keypair midstate and the last pubkey byte
+void sha256_tail_final(const Sha256TailTemplate* tail, const uint32_t midstate[8],
+                       uint8_t last_pubkey_byte, uint32_t digest[8]);
+
+// Only the first big-endian digest word, for early rejection. Bit-exact with
+// digest[0] of sha256_tail_final().
+uint32_t sha256_tail_word0(const Sha256TailTemplate* tail, const uint32_t midstate[8],
+                           uint8_t last_pubkey_byte);
+
+// Check the midstate/template path against OpenSSL, called once at startup
+bool sha256_self_test(void);
+
+#endif // SHA256_H
@@ -2,6 +2,8 @@
 #define SIMD_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <immintrin.h>
 
 // Check if AVX-512 is supported
@@ -13,20 +15,20 @@ static inline int check_avx512_support(void) {
     #endif
 }
 
-// SIMD-optimized hash comparison
+// SIMD-optimized hash comparison (32-byte hashes)
 static inline int compare_hash_simd(const uint8_t* hash1, const uint8_t* hash2) {
-    #ifdef __AVX512F__
-    __m512i v1 = _mm512_loadu_si512((__m512i*)hash1);
-    __m512i v2 = _mm512_loadu_si512((__m512i*)hash2);
-    __mmask64 mask = _mm512_cmpeq_epi8_mask(v1, v2);
+    #ifdef __AVX2__
+    __m256i v1 = _mm256_loadu_si256((const __m256i*)hash1);
+    __m256i v2 = _mm256_loadu_si256((const __m256i*)hash2);
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, v2));
     
     // If all bytes are equal, return 0
-    if (mask == 0xFFFFFFFFFFFFFFFF) {
+    if (mask == 0xFFFFFFFF) {
         return 0;
     }
     
     // Find first differing byte
-    int first_diff = __builtin_ctzll(~mask);
+    int first_diff = __builtin_ctz(~mask);
     return hash1[first_diff] < hash2[first_diff] ? -1 : 1;
     #else
     // Fallback to scalar comparison
@@ -79,4 +81,99 @@ static inline void memcpy_simd(uint8_t* dest, const uint8_t* src, size_t len) {
     #endif
 }
 
+// Lowercase hex encoding of len bytes into dest (2 * len chars, not terminated).
+// Splits every byte into nibbles and maps them through a 16-entry pshufb table.
+static inline void hex_encode_simd(char* dest, const uint8_t* src, size_t len) {
+    static const char digits[16] = "0123456789abcdef";
+    size_t i = 0;
+    #ifdef __AVX2__
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)digits));
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, mask));
+        // Unpacks work per 128-bit lane, so put the lanes back in order afterwards
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i*)(dest + i * 2), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)(dest + i * 2 + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    #endif
+    #ifdef __SSSE3__
+    const __m128i table128 = _mm_loadu_si128((const __m128i*)digits);
+    const __m128i mask128 = _mm_set1_epi8(0x0F);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i hi = _mm_shuffle_epi8(table128, _mm_and_si128(_mm_srli_epi16(v, 4), mask128));
+        __m128i lo = _mm_shuffle_epi8(table128, _mm_and_si128(v, mask128));
+        _mm_storeu_si128((__m128i*)(dest + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(dest + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    #endif
+    for (; i < len; i++) {
+        dest[i * 2] = digits[src[i] >> 4];
+        dest[i * 2 + 1] = digits[src[i] & 0x0F];
+    }
+}
+
+static inline int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+#ifdef __SSSE3__
+// Decode 32 hex chars into 16 bytes. Returns false on any non-hex char.
+static inline bool hex_decode_block16(uint8_t* dest, const char* src) {
+    const __m128i zero_char = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i five = _mm_set1_epi8(5);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i a_char = _mm_set1_epi8('a');
+    const __m128i ten = _mm_set1_epi8(10);
+    const __m128i weights = _mm_set1_epi16(0x0110);   // high nibble * 16 + low nibble * 1
+    __m128i out[2];
+
+    for (int half = 0; half < 2; half++) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + half * 16));
+        __m128i digit = _mm_sub_epi8(c, zero_char);
+        __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, case_bit), a_char);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+        __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, five), alpha);
+        if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xFFFF) {
+            return false;
+        }
+        __m128i nibbles = _mm_or_si128(_mm_and_si128(is_digit, digit),
+                                       _mm_andnot_si128(is_digit, _mm_add_epi8(alpha, ten)));
+        out[half] = _mm_maddubs_epi16(nibbles, weights);
+    }
+    _mm_storeu_si128((__m128i*)dest, _mm_packus_epi16(out[0], out[1]));
+    return true;
+}
+#endif
+
+// Decode 2 * len hex chars (either case) into len bytes. Returns false on any
+// non-hex char, in which case dest is left partially written.
+static inline bool hex_decode_simd(uint8_t* dest, const char* src, size_t len) {
+    size_t i = 0;
+    #ifdef __SSSE3__
+    for (; i + 16 <= len; i += 16) {
+        if (!hex_decode_block16(dest + i, src + i * 2)) {
+            return false;
+        }
+    }
+    #endif
+    for (; i < len; i++) {
+        int hi = hex_nibble(src[i * 2]);
+        int lo = hex_nibble(src[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return false;
+        }
+        dest[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return true;
+}
+
 #endif // SIMD_H 
\ No newline at end of file
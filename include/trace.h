@@ -0,0 +1,40 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hot-path tracepoints. Build with `make TRACE=1` to enable; otherwise every
+// macro below expands to nothing and the hot path is untouched.
+
+typedef enum {
+    TRACE_JOB_CHECK = 0,   // Job mutex + job copy in mining_thread()
+    TRACE_POOL_FETCH,      // get_next_keypair()
+    TRACE_HASH,            // Final SHA-256 compressions from the midstate
+    TRACE_COMPARE,         // Best hash + difficulty comparison
+    TRACE_SUBMIT,          // submit_solution() round trip
+    TRACE_EVENT_COUNT
+} TraceEvent;
+
+#ifdef CMINER_TRACE
+
+#include <x86intrin.h>
+
+void trace_record(TraceEvent event, uint64_t start, uint64_t end);
+
+#define TRACE_BEGIN(name) uint64_t trace_start_##name = __rdtsc()
+#define TRACE_END(name, event) trace_record((event), trace_start_##name, __rdtsc())
+
+#else
+
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name, event) ((void)0)
+
+#endif // CMINER_TRACE
+
+void trace_init(void);
+// Write all per-thread rings as a Chrome trace (chrome://tracing, Perfetto).
+// Returns false if tracing is compiled out or the file cannot be written.
+bool trace_dump(const char* path);
+
+#endif // TRACE_H
@@ -0,0 +1,353 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "../include/miner.h"
+#include "../include/metrics.h"
+#include "../include/autotune.h"
+
+// Synthetic pool for the trials, ~16 MB so it doesn't fit in cache either
+#define TUNE_KEYPAIRS (128 * 1024)
+#define TUNE_WARMUP_MS 50
+#define TUNE_TRIAL_MS 300
+// A setting other than the default has to win by this much to be picked
+#define TUNE_MIN_GAIN 1.02
+
+static const int tune_batches[] = {100, 500, 2000};
+
+// Hashing code compiled in, cached profiles only apply to the same build
+#ifdef __SHA__
+#define TUNE_SHA256 "sha-ni"
+#else
+#define TUNE_SHA256 "portable"
+#endif
+#ifdef CMINER_OPENCL
+#define TUNE_BUILD TUNE_SHA256 "+opencl"
+#else
+#define TUNE_BUILD TUNE_SHA256
+#endif
+
+typedef struct {
+    const Keypair* keypairs;
+    Sha256TailTemplate tail;
+    Job* job;                   // Device trials only, a difficulty nothing meets
+    pthread_mutex_t job_mutex;  // Taken between batches like the real job check
+    _Atomic size_t cursor;
+    _Atomic bool stop;
+} TuneBench;
+
+typedef struct {
+    TuneBench* bench;
+    int batch;
+    uint32_t best;              // Keeps the hashing from being optimized out
+    _Atomic uint64_t hashes;
+    char pad[64];
+} TuneWorker;
+
+const char* affinity_name(AffinityLayout layout) {
+    switch (layout) {
+        case AFFINITY_COMPACT: return "compact";
+        case AFFINITY_SPREAD: return "spread";
+        default: return "none";
+    }
+}
+
+static AffinityLayout parse_affinity(const char* name) {
+    if (strcmp(name, "compact") == 0) return AFFINITY_COMPACT;
+    if (strcmp(name, "spread") == 0) return AFFINITY_SPREAD;
+    return AFFINITY_NONE;
+}
+
+void pin_mining_thread(pthread_t thread, AffinityLayout layout, int index) {
+    if (layout == AFFINITY_NONE) return;
+
+    int cpus[CPU_SETSIZE];
+    int count = get_cpu_order(cpus, CPU_SETSIZE, layout == AFFINITY_SPREAD);
+    if (count == 0) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[index % count], &set);
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+// The mining loop without pool generation or job handling
+static void* tune_thread(void* arg) {
+    TuneWorker* worker = (TuneWorker*)arg;
+    TuneBench* bench = worker->bench;
+    size_t next = 0;
+    size_t end = 0;
+    uint32_t best = UINT32_MAX;
+
+    while (!atomic_load_explicit(&bench->stop, memory_order_relaxed)) {
+        pthread_mutex_lock(&bench->job_mutex);
+        pthread_mutex_unlock(&bench->job_mutex);
+
+        for (int i = 0; i < worker->batch; i++) {
+            if (next == end) {
+                next = atomic_fetch_add_explicit(&bench->cursor, KEYPAIR_CLAIM_SIZE, memory_order_relaxed);
+                end = next + KEYPAIR_CLAIM_SIZE;
+            }
+            const Keypair* keypair = &bench->keypairs[next++ % TUNE_KEYPAIRS];
+            uint32_t word0 = sha256_tail_word0(&bench->tail, keypair->midstate, keypair->public_key[64]);
+            if (word0 < best) best = word0;
+        }
+        atomic_fetch_add_explicit(&worker->hashes, worker->batch, memory_order_relaxed);
+    }
+
+    worker->best = best;
+    return NULL;
+}
+
+// Back-to-back device dispatches, like the device thread without job handling
+static void* tune_device_thread(void* arg) {
+    TuneWorker* worker = (TuneWorker*)arg;
+    TuneBench* bench = worker->bench;
+    size_t start = 0;
+
+    while (!atomic_load_explicit(&bench->stop, memory_order_relaxed)) {
+        uint64_t hashed = mine_backend_trial(bench->job, start);
+        if (hashed == 0) {
+            worker->best = 0;  // Marks the trial as failed
+            break;
+        }
+        start += hashed;
+        atomic_fetch_add_explicit(&worker->hashes, hashed, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+static uint64_t total_hashes(TuneWorker* workers, int count) {
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += atomic_load_explicit(&workers[i].hashes, memory_order_relaxed);
+    }
+    return total;
+}
+
+// Total H/s of threads hashing with the given settings, plus the device
+// dispatching next to them if device is set. 0 on failure.
+static double run_trial(TuneBench* bench, int threads, int batch, AffinityLayout affinity, bool device) {
+    int total = threads + (device ? 1 : 0);
+    TuneWorker* workers = calloc(total, sizeof(TuneWorker));
+    pthread_t* tids = calloc(total, sizeof(pthread_t));
+    if (!workers || !tids) {
+        free(workers);
+        free(tids);
+        return 0;
+    }
+
+    atomic_store(&bench->stop, false);
+    int started = 0;
+    for (; started < threads; started++) {
+        workers[started].bench = bench;
+        workers[started].batch = batch;
+        if (pthread_create(&tids[started], NULL, tune_thread, &workers[started]) != 0) {
+            break;
+        }
+        pin_mining_thread(tids[started], affinity, started);
+    }
+    if (device && started == threads) {
+        workers[started].bench = bench;
+        workers[started].best = UINT32_MAX;
+        if (pthread_create(&tids[started], NULL, tune_device_thread, &workers[started]) == 0) {
+            started++;
+        }
+    }
+
+    usleep(TUNE_WARMUP_MS * 1000);
+    uint64_t start_hashes = total_hashes(workers, started);
+    uint64_t start_ns = metrics_now_ns();
+    usleep(TUNE_TRIAL_MS * 1000);
+    uint64_t hashes = total_hashes(workers, started) - start_hashes;
+    uint64_t elapsed_ns = metrics_now_ns() - start_ns;
+
+    atomic_store(&bench->stop, true);
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+
+    bool failed = started < total || (device && workers[threads].best == 0);
+    double rate = failed ? 0 : hashes / (elapsed_ns / 1e9);
+    printf("%s[INFO] Tune: %d threads%s, batch %d, affinity %s: %.2f MH/s%s\n",
+        ANSI_COLOR_CYAN, threads, device ? " + device" : "", batch, affinity_name(affinity), rate / 1e6,
+        ANSI_COLOR_RESET);
+    free(workers);
+    free(tids);
+    return rate;
+}
+
+// Device column of a cache line: "-" when no compute backend took part in the
+// trials, otherwise whether its device thread won
+static const char* device_name(bool backend, bool device) {
+    if (!backend) return "-";
+    return device ? "device" : "no-device";
+}
+
+// Cache lines: <cpus> <threads> <batch> <affinity> <device> <hash_rate> <build> <cpu model>
+static bool load_profile(const char* path, int cpus, const char* model, bool backend, TuneProfile* profile) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+
+    bool found = false;
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        int line_cpus, threads, batch, model_offset = 0;
+        char affinity[16];
+        char device[16];
+        char build[32];
+        double hash_rate;
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "%d %d %d %15s %15s %lf %31s %n", &line_cpus, &threads, &batch, affinity, device,
+                   &hash_rate, build, &model_offset) != 7 ||
+            model_offset == 0 || line_cpus != cpus || strcmp(build, TUNE_BUILD) != 0 ||
+            (strcmp(device, device_name(backend, true)) != 0 && strcmp(device, device_name(backend, false)) != 0) ||
+            strcmp(line + model_offset, model) != 0 || threads <= 0 || batch <= 0) {
+            continue;
+        }
+        // Later lines are newer runs
+        profile->threads = threads;
+        profile->batch = batch;
+        profile->affinity = parse_affinity(affinity);
+        profile->device = strcmp(device, "device") == 0;
+        profile->hash_rate = hash_rate;
+        found = true;
+    }
+    fclose(fp);
+    return found;
+}
+
+static void save_profile(const char* path, int cpus, const char* model, bool backend, const TuneProfile* profile) {
+    FILE* fp = fopen(path, "a");
+    if (!fp) {
+        printf("%s[WARN] Cannot write tune cache %s%s\n", ANSI_COLOR_YELLOW, path, ANSI_COLOR_RESET);
+        return;
+    }
+    fprintf(fp, "%d %d %d %s %s %.0f %s %s\n", cpus, profile->threads, profile->batch,
+        affinity_name(profile->affinity), device_name(backend, profile->device), profile->hash_rate,
+        TUNE_BUILD, model);
+    fclose(fp);
+}
+
+bool autotune(const char* cache_path, bool backend, TuneProfile* profile) {
+    char model[256];
+    get_cpu_model(model, sizeof(model));
+    int cpus = get_available_cpus();
+    if (cpus > MAX_THREADS) cpus = MAX_THREADS;
+
+    if (load_profile(cache_path, cpus, model, backend, profile)) {
+        printf("%s[INFO] Tuned profile for %s (%d CPUs, %s build): %d threads, batch %d, affinity %s%s%s\n",
+            ANSI_COLOR_BLUE, model, cpus, TUNE_BUILD, profile->threads, profile->batch,
+            affinity_name(profile->affinity), backend ? (profile->device ? ", device on" : ", device off") : "",
+            ANSI_COLOR_RESET);
+        return true;
+    }
+
+    printf("%s[INFO] Tuning for %s (%d CPUs, %s build), this takes a few seconds...%s\n",
+        ANSI_COLOR_BLUE, model, cpus, TUNE_BUILD, ANSI_COLOR_RESET);
+
+    TuneBench* bench = calloc(1, sizeof(TuneBench));
+    Keypair* keypairs = malloc(TUNE_KEYPAIRS * sizeof(Keypair));
+    Job* job = backend ? calloc(1, sizeof(Job)) : NULL;
+    if (!bench || !keypairs || (backend && !job)) {
+        free(bench);
+        free(keypairs);
+        free(job);
+        return false;
+    }
+    // Hash cost doesn't depend on the key, any midstate will do
+    uint32_t x = 2463534242u;
+    for (size_t i = 0; i < TUNE_KEYPAIRS; i++) {
+        for (int j = 0; j < 8; j++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            keypairs[i].midstate[j] = x;
+        }
+        keypairs[i].public_key[64] = (uint8_t)x;
+    }
+    bench->keypairs = keypairs;
+    static const char seed[] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+    sha256_build_tail(&bench->tail, seed, sizeof(seed) - 1);
+    pthread_mutex_init(&bench->job_mutex, NULL);
+    if (backend) {
+        job->tail = bench->tail;  // All-zero difficulty, so the device reports no hits
+        bench->job = job;
+        if (!load_backend_trial(keypairs, TUNE_KEYPAIRS)) {
+            backend = false;
+        }
+    }
+
+    // One setting at a time, starting from every usable CPU, scheduler placement
+    // and the built-in batch
+    TuneProfile best = {cpus, tune_batches[0], AFFINITY_NONE, false, 0};
+    best.hash_rate = run_trial(bench, best.threads, best.batch, best.affinity, false);
+
+    int cores = get_physical_cores();
+    if (cores < cpus) {
+        double rate = run_trial(bench, cores, best.batch, best.affinity, false);
+        if (rate > best.hash_rate * TUNE_MIN_GAIN) {
+            best.threads = cores;
+            best.hash_rate = rate;
+        }
+    }
+
+    AffinityLayout layouts[] = {AFFINITY_COMPACT, AFFINITY_SPREAD};
+    for (int i = 0; i < 2; i++) {
+        // Without SMT both orders are the same
+        if (layouts[i] == AFFINITY_SPREAD && cores >= cpus) continue;
+        double rate = run_trial(bench, best.threads, best.batch, layouts[i], false);
+        if (rate > best.hash_rate * TUNE_MIN_GAIN) {
+            best.affinity = layouts[i];
+            best.hash_rate = rate;
+        }
+    }
+
+    for (size_t i = 1; i < sizeof(tune_batches) / sizeof(tune_batches[0]); i++) {
+        double rate = run_trial(bench, best.threads, tune_batches[i], best.affinity, false);
+        if (rate > best.hash_rate * TUNE_MIN_GAIN) {
+            best.batch = tune_batches[i];
+            best.hash_rate = rate;
+        }
+    }
+
+    // Then the configured device next to the tuned threads, or next to one
+    // thread fewer since feeding it takes a CPU too. The CPU threads alone
+    // have to beat it by the same margin to switch it off.
+    if (backend) {
+        TuneProfile device = best;
+        device.device = true;
+        if (device.threads > MAX_THREADS - 1) device.threads = MAX_THREADS - 1;
+        device.hash_rate = run_trial(bench, device.threads, device.batch, device.affinity, true);
+        if (device.threads > 1) {
+            double rate = run_trial(bench, device.threads - 1, device.batch, device.affinity, true);
+            if (rate > device.hash_rate) {
+                device.threads--;
+                device.hash_rate = rate;
+            }
+        }
+        if (device.hash_rate > 0 && best.hash_rate <= device.hash_rate * TUNE_MIN_GAIN) {
+            best = device;
+        }
+    }
+
+    pthread_mutex_destroy(&bench->job_mutex);
+    free(keypairs);
+    free(job);
+    free(bench);
+
+    if (best.hash_rate <= 0) {
+        printf("%s[WARN] Tuning failed, using defaults%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    *profile = best;
+    printf("%s[INFO] Tuned: %d threads, batch %d, affinity %s%s, %.2f MH/s%s\n",
+        ANSI_COLOR_GREEN, best.threads, best.batch, affinity_name(best.affinity),
+        backend ? (best.device ? ", device on" : ", device off") : "", best.hash_rate / 1e6, ANSI_COLOR_RESET);
+    save_profile(cache_path, cpus, model, backend, &best);
+    return true;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/rand.h>
+#include "../include/backend.h"
+
+// Candidates in the self test. Small enough to run at startup on any device.
+#define SELF_TEST_CANDIDATES 1024
+#define SELF_TEST_MAX_HITS SELF_TEST_CANDIDATES
+
+typedef struct {
+    const Keypair* keypairs;
+} CpuBackend;
+
+static bool digest_meets(const uint32_t digest[8], const uint32_t diff_words[8]) {
+    for (int i = 0; i < 8; i++) {
+        if (digest[i] != diff_words[i]) {
+            return digest[i] < diff_words[i];
+        }
+    }
+    return true;
+}
+
+static bool cpu_upload(ComputeBackend* backend, const Keypair* keypairs, size_t start, size_t count) {
+    (void)start;
+    (void)count;
+    // Hashes straight out of the caller's array
+    ((CpuBackend*)backend->impl)->keypairs = keypairs;
+    return true;
+}
+
+static bool cpu_search(ComputeBackend* backend, const Job* job, size_t pool_size, size_t start,
+                       size_t count, uint32_t* hits, size_t max_hits, size_t* hit_count) {
+    const Keypair* keypairs = ((CpuBackend*)backend->impl)->keypairs;
+    if (!keypairs || pool_size == 0) {
+        return false;
+    }
+
+    *hit_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t index = (start + i) % pool_size;
+        const Keypair* keypair = &keypairs[index];
+        if (sha256_tail_word0(&job->tail, keypair->midstate, keypair->public_key[64]) > job->diff_words[0]) {
+            continue;
+        }
+
+        uint32_t digest[8];
+        sha256_tail_final(&job->tail, keypair->midstate, keypair->public_key[64], digest);
+        if (digest_meets(digest, job->diff_words)) {
+            if (*hit_count < max_hits) {
+                hits[*hit_count] = (uint32_t)index;
+            }
+            (*hit_count)++;
+        }
+    }
+    return true;
+}
+
+static void cpu_destroy(ComputeBackend* backend) {
+    if (backend) {
+        free(backend->impl);
+        free(backend);
+    }
+}
+
+ComputeBackend* create_cpu_backend(void) {
+    ComputeBackend* backend = calloc(1, sizeof(ComputeBackend));
+    CpuBackend* cpu = calloc(1, sizeof(CpuBackend));
+    if (!backend || !cpu) {
+        free(backend);
+        free(cpu);
+        return NULL;
+    }
+
+    backend->name = "cpu";
+    backend->upload = cpu_upload;
+    backend->search = cpu_search;
+    backend->destroy = cpu_destroy;
+    backend->impl = cpu;
+    return backend;
+}
+
+static int compare_index(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+bool backend_self_test(ComputeBackend* backend, size_t capacity) {
+    // Seed lengths around the tail block boundaries
+    static const size_t seed_lengths[] = {0, 1, 53, 54, 64, 117, 118, 200, MAX_SEED_LEN};
+    static const char digits[16] = "0123456789abcdef";
+
+    size_t count = capacity < SELF_TEST_CANDIDATES ? capacity : SELF_TEST_CANDIDATES;
+    Keypair* keypairs = calloc(count, sizeof(Keypair));
+    uint32_t* expected = malloc(SELF_TEST_MAX_HITS * sizeof(uint32_t));
+    uint32_t* actual = malloc(SELF_TEST_MAX_HITS * sizeof(uint32_t));
+    Job* job = calloc(1, sizeof(Job));
+    ComputeBackend* reference = create_cpu_backend();
+    bool ok = keypairs && expected && actual && job && reference && count > 0;
+
+    // Hashing only reads the midstate and last pubkey byte, so random bytes will do
+    if (ok && RAND_bytes((uint8_t*)keypairs, (int)(count * sizeof(Keypair))) != 1) {
+        ok = false;
+    }
+    if (ok) {
+        ok = reference->upload(reference, keypairs, 0, count) && backend->upload(backend, keypairs, 0, count);
+    }
+
+    size_t total_hits = 0;
+    size_t tests = sizeof(seed_lengths) / sizeof(seed_lengths[0]);
+    for (size_t t = 0; ok && t < tests; t++) {
+        char seed[MAX_SEED_LEN];
+        size_t seed_len = seed_lengths[t];
+
+        // Halfway, rewrite part of the pool the way pool_refresh does and
+        // upload just that range again
+        if (t == tests / 2) {
+            size_t first = count / 4;
+            size_t rewritten = count / 4 > 0 ? count / 4 : 1;
+            if (RAND_bytes((uint8_t*)&keypairs[first], (int)(rewritten * sizeof(Keypair))) != 1 ||
+                !reference->upload(reference, keypairs, first, rewritten) ||
+                !backend->upload(backend, keypairs, first, rewritten)) {
+                ok = false;
+                break;
+            }
+        }
+        if (RAND_bytes((uint8_t*)seed, (int)seed_len) != 1) {
+            ok = false;
+            break;
+        }
+        for (size_t i = 0; i < seed_len; i++) {
+            seed[i] = digits[seed[i] & 0x0F];
+        }
+        if (!sha256_build_tail(&job->tail, seed, seed_len)) {
+            ok = false;
+            break;
+        }
+
+        // Roughly one hit in 16, with the full-word compare exercised too
+        memset(job->diff_words, 0xFF, sizeof(job->diff_words));
+        job->diff_words[0] = 0x0FFFFFFF;
+        job->diff_words[1] = (uint32_t)t << 28;
+
+        // Start mid-pool so the search wraps around
+        size_t expected_count = 0;
+        size_t actual_count = 0;
+        if (!reference->search(reference, job, count, count / 2, count, expected, SELF_TEST_MAX_HITS, &expected_count) ||
+            !backend->search(backend, job, count, count / 2, count, actual, SELF_TEST_MAX_HITS, &actual_count)) {
+            ok = false;
+            break;
+        }
+
+        // Devices report hits in any order
+        qsort(expected, expected_count, sizeof(uint32_t), compare_index);
+        qsort(actual, actual_count, sizeof(uint32_t), compare_index);
+        if (expected_count != actual_count ||
+            memcmp(expected, actual, expected_count * sizeof(uint32_t)) != 0) {
+            printf("%s[ERROR] %s backend self check failed for seed length %zu (%zu hits, expected %zu)%s\n",
+                ANSI_COLOR_RED, backend->name, seed_len, actual_count, expected_count, ANSI_COLOR_RESET);
+            ok = false;
+            break;
+        }
+        total_hits += expected_count;
+    }
+
+    if (ok) {
+        printf("%s[INFO] %s backend self check passed (%zu hits)%s\n",
+            ANSI_COLOR_BLUE, backend->name, total_hits, ANSI_COLOR_RESET);
+    }
+
+    if (reference) {
+        reference->destroy(reference);
+    }
+    free(keypairs);
+    free(expected);
+    free(actual);
+    free(job);
+    return ok;
+}
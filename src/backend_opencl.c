@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/backend.h"
+
+#ifdef CMINER_OPENCL
+
+#define CL_TARGET_OPENCL_VERSION 120
+#include <CL/cl.h>
+
+// Hit indices read back per dispatch; anything past this is dropped and counted
+#define OPENCL_MAX_HITS 4096
+
+// Everything the kernel needs for a job. All members are 32-bit, so the
+// layout is the same on the host and in the kernel's JobParams.
+typedef struct {
+    Sha256TailTemplate tail;
+    uint32_t diff_words[8];
+} OpenCLJob;
+
+// One work item per candidate. Midstates are stored word-major
+// (midstates[word * capacity + index]) so neighbouring work items read
+// neighbouring addresses.
+static const char* kernel_source =
+"typedef struct {\n"
+"    int blocks;\n"
+"    uint w0_low;\n"
+"    uint kw_first[16];\n"
+"    uint w_first[16];\n"
+"    uint w_pre[64];\n"
+"    uint kw_rest[MAX_REST_BLOCKS][64];\n"
+"    uint diff_words[8];\n"
+"} JobParams;\n"
+"\n"
+"#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))\n"
+"#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))\n"
+"#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))\n"
+"#define EP0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))\n"
+"#define EP1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))\n"
+"#define SIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))\n"
+"#define SIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))\n"
+"#define ROUND(kw) { \\\n"
+"    uint t1 = h + EP1(e) + CH(e, f, g) + (kw); \\\n"
+"    uint t2 = EP0(a) + MAJ(a, b, c); \\\n"
+"    h = g; g = f; f = e; e = d + t1; \\\n"
+"    d = c; c = b; b = a; a = t1 + t2; }\n"
+"\n"
+"__constant uint K[64] = {\n"
+"    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,\n"
+"    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,\n"
+"    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,\n"
+"    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,\n"
+"    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,\n"
+"    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,\n"
+"    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,\n"
+"    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2\n"
+"};\n"
+"\n"
+"__kernel void search(__global const uint* midstates, __global const uchar* last_bytes,\n"
+"                     __constant JobParams* job, ulong capacity, ulong start, ulong pool_size,\n"
+"                     __global uint* hits, volatile __global uint* hit_count, uint max_hits) {\n"
+"    ulong index = (start + get_global_id(0)) % pool_size;\n"
+"    uint last = last_bytes[index];\n"
+"    uint hi = last >> 4;\n"
+"    uint lo = last & 15;\n"
+"\n"
+"    // Only word 0 of the first tail block depends on the candidate. Words\n"
+"    // 1..15 are already in kw_first, and w_pre holds every term of W[16..31]\n"
+"    // that doesn't read word 0 or an expanded word (see first_block_schedule).\n"
+"    uint w[64];\n"
+"    w[0] = ((hi < 10 ? 48 + hi : 87 + hi) << 24) | ((lo < 10 ? 48 + lo : 87 + lo) << 16) | job->w0_low;\n"
+"    w[16] = job->w_pre[16] + w[0];\n"
+"    w[17] = job->w_pre[17];\n"
+"    for (int t = 18; t < 23; t++) w[t] = job->w_pre[t] + SIG1(w[t - 2]);\n"
+"    for (int t = 23; t < 31; t++) w[t] = job->w_pre[t] + SIG1(w[t - 2]) + w[t - 7];\n"
+"    w[31] = job->w_pre[31] + SIG1(w[29]) + w[24] + SIG0(w[16]);\n"
+"    for (int t = 32; t < 64; t++) w[t] = SIG1(w[t - 2]) + w[t - 7] + SIG0(w[t - 15]) + w[t - 16];\n"
+"\n"
+"    uint s[8];\n"
+"    for (int i = 0; i < 8; i++) s[i] = midstates[i * capacity + index];\n"
+"\n"
+"    uint a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];\n"
+"    ROUND(K[0] + w[0])\n"
+"    for (int t = 1; t < 16; t++) ROUND(job->kw_first[t])\n"
+"    for (int t = 16; t < 64; t++) ROUND(K[t] + w[t])\n"
+"    s[0] += a; s[1] += b; s[2] += c; s[3] += d; s[4] += e; s[5] += f; s[6] += g; s[7] += h;\n"
+"\n"
+"    for (int blk = 1; blk < job->blocks; blk++) {\n"
+"        a = s[0]; b = s[1]; c = s[2]; d = s[3]; e = s[4]; f = s[5]; g = s[6]; h = s[7];\n"
+"        for (int t = 0; t < 64; t++) ROUND(job->kw_rest[blk - 1][t])\n"
+"        s[0] += a; s[1] += b; s[2] += c; s[3] += d; s[4] += e; s[5] += f; s[6] += g; s[7] += h;\n"
+"    }\n"
+"\n"
+"    // Big-endian digest words against the difficulty, most significant first\n"
+"    for (int i = 0; i < 8; i++) {\n"
+"        if (s[i] != job->diff_words[i]) {\n"
+"            if (s[i] > job->diff_words[i]) return;\n"
+"            break;\n"
+"        }\n"
+"    }\n"
+"    uint slot = atomic_inc(hit_count);\n"
+"    if (slot < max_hits) hits[slot] = (uint)index;\n"
+"}\n";
+
+typedef struct {
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+    cl_kernel kernel;
+    cl_mem midstates;
+    cl_mem last_bytes;
+    cl_mem job;
+    cl_mem hits;
+    cl_mem hit_count;
+    size_t capacity;
+    uint32_t* staging;     // One midstate word for a range of keypairs
+    uint8_t* staging_last;
+} OpenCLBackend;
+
+static bool cl_check(cl_int err, const char* what) {
+    if (err != CL_SUCCESS) {
+        printf("%s[ERROR] OpenCL %s failed (%d)%s\n", ANSI_COLOR_RED, what, (int)err, ANSI_COLOR_RESET);
+        return false;
+    }
+    return true;
+}
+
+// Keypairs are copied through the staging arrays in chunks of this many
+#define UPLOAD_CHUNK 65536
+
+static bool opencl_upload(ComputeBackend* backend, const Keypair* keypairs, size_t start, size_t count) {
+    OpenCLBackend* cl = (OpenCLBackend*)backend->impl;
+    if (start + count > cl->capacity) {
+        return false;
+    }
+
+    for (size_t done = 0; done < count; done += UPLOAD_CHUNK) {
+        size_t n = count - done < UPLOAD_CHUNK ? count - done : UPLOAD_CHUNK;
+        size_t first = start + done;
+
+        for (size_t i = 0; i < n; i++) {
+            cl->staging_last[i] = keypairs[first + i].public_key[64];
+        }
+        if (!cl_check(clEnqueueWriteBuffer(cl->queue, cl->last_bytes, CL_TRUE, first, n,
+                                           cl->staging_last, 0, NULL, NULL), "write last bytes")) {
+            return false;
+        }
+
+        for (int word = 0; word < 8; word++) {
+            for (size_t i = 0; i < n; i++) {
+                cl->staging[i] = keypairs[first + i].midstate[word];
+            }
+            size_t offset = (word * cl->capacity + first) * sizeof(uint32_t);
+            if (!cl_check(clEnqueueWriteBuffer(cl->queue, cl->midstates, CL_TRUE, offset, n * sizeof(uint32_t),
+                                               cl->staging, 0, NULL, NULL), "write midstates")) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool opencl_search(ComputeBackend* backend, const Job* job, size_t pool_size, size_t start,
+                          size_t count, uint32_t* hits, size_t max_hits, size_t* hit_count) {
+    OpenCLBackend* cl = (OpenCLBackend*)backend->impl;
+    OpenCLJob params;
+    cl_uint zero = 0;
+    cl_uint found = 0;
+    cl_ulong capacity = cl->capacity;
+    cl_ulong first = start % pool_size;
+    cl_ulong size = pool_size;
+    cl_uint device_max_hits = OPENCL_MAX_HITS;
+
+    params.tail = job->tail;
+    memcpy(params.diff_words, job->diff_words, sizeof(params.diff_words));
+
+    // The job is a couple of KB, cheap enough to send with every dispatch
+    if (!cl_check(clEnqueueWriteBuffer(cl->queue, cl->job, CL_FALSE, 0, sizeof(params), &params, 0, NULL, NULL), "write job") ||
+        !cl_check(clEnqueueWriteBuffer(cl->queue, cl->hit_count, CL_FALSE, 0, sizeof(zero), &zero, 0, NULL, NULL), "reset hits")) {
+        return false;
+    }
+
+    cl_int err = CL_SUCCESS;
+    err |= clSetKernelArg(cl->kernel, 0, sizeof(cl_mem), &cl->midstates);
+    err |= clSetKernelArg(cl->kernel, 1, sizeof(cl_mem), &cl->last_bytes);
+    err |= clSetKernelArg(cl->kernel, 2, sizeof(cl_mem), &cl->job);
+    err |= clSetKernelArg(cl->kernel, 3, sizeof(cl_ulong), &capacity);
+    err |= clSetKernelArg(cl->kernel, 4, sizeof(cl_ulong), &first);
+    err |= clSetKernelArg(cl->kernel, 5, sizeof(cl_ulong), &size);
+    err |= clSetKernelArg(cl->kernel, 6, sizeof(cl_mem), &cl->hits);
+    err |= clSetKernelArg(cl->kernel, 7, sizeof(cl_mem), &cl->hit_count);
+    err |= clSetKernelArg(cl->kernel, 8, sizeof(cl_uint), &device_max_hits);
+    if (!cl_check(err, "set kernel args")) {
+        return false;
+    }
+
+    size_t global = count;
+    if (!cl_check(clEnqueueNDRangeKernel(cl->queue, cl->kernel, 1, NULL, &global, NULL, 0, NULL, NULL), "dispatch") ||
+        !cl_check(clEnqueueReadBuffer(cl->queue, cl->hit_count, CL_TRUE, 0, sizeof(found), &found, 0, NULL, NULL), "read hit count")) {
+        return false;
+    }
+
+    *hit_count = found;
+    size_t readable = found < OPENCL_MAX_HITS ? found : OPENCL_MAX_HITS;
+    if (readable > max_hits) {
+        readable = max_hits;
+    }
+    if (readable > 0 &&
+        !cl_check(clEnqueueReadBuffer(cl->queue, cl->hits, CL_TRUE, 0, readable * sizeof(uint32_t), hits, 0, NULL, NULL), "read hits")) {
+        return false;
+    }
+    return true;
+}
+
+static void opencl_destroy(ComputeBackend* backend) {
+    if (!backend) return;
+
+    OpenCLBackend* cl = (OpenCLBackend*)backend->impl;
+    if (cl) {
+        if (cl->hit_count) clReleaseMemObject(cl->hit_count);
+        if (cl->hits) clReleaseMemObject(cl->hits);
+        if (cl->job) clReleaseMemObject(cl->job);
+        if (cl->last_bytes) clReleaseMemObject(cl->last_bytes);
+        if (cl->midstates) clReleaseMemObject(cl->midstates);
+        if (cl->kernel) clReleaseKernel(cl->kernel);
+        if (cl->program) clReleaseProgram(cl->program);
+        if (cl->queue) clReleaseCommandQueue(cl->queue);
+        if (cl->context) clReleaseContext(cl->context);
+        free(cl->staging);
+        free(cl->staging_last);
+        free(cl);
+    }
+    free(backend);
+}
+
+static bool pick_device(const char* spec, cl_device_id* device) {
+    unsigned platform_index = 0;
+    unsigned device_index = 0;
+    if (spec && spec[0] && sscanf(spec, "%u:%u", &platform_index, &device_index) != 2) {
+        printf("%s[ERROR] opencl_device must be \"platform:device\", got \"%s\"%s\n",
+            ANSI_COLOR_RED, spec, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    cl_platform_id platforms[16];
+    cl_uint platform_count = 0;
+    if (!cl_check(clGetPlatformIDs(16, platforms, &platform_count), "platform query")) {
+        return false;
+    }
+    if (platform_index >= platform_count) {
+        printf("%s[ERROR] OpenCL platform %u not found (%u available)%s\n",
+            ANSI_COLOR_RED, platform_index, platform_count, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    // Any device type, so CPU drivers such as POCL work as well as GPUs
+    cl_device_id devices[64];
+    cl_uint device_count = 0;
+    if (!cl_check(clGetDeviceIDs(platforms[platform_index], CL_DEVICE_TYPE_ALL, 64, devices, &device_count), "device query")) {
+        return false;
+    }
+    if (device_index >= device_count) {
+        printf("%s[ERROR] OpenCL device %u not found on platform %u (%u available)%s\n",
+            ANSI_COLOR_RED, device_index, platform_index, device_count, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    char name[256] = {0};
+    char platform_name[256] = {0};
+    clGetPlatformInfo(platforms[platform_index], CL_PLATFORM_NAME, sizeof(platform_name) - 1, platform_name, NULL);
+    clGetDeviceInfo(devices[device_index], CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+    printf("%s[INFO] OpenCL device: %s (%s)%s\n", ANSI_COLOR_BLUE, name, platform_name, ANSI_COLOR_RESET);
+
+    *device = devices[device_index];
+    return true;
+}
+
+ComputeBackend* create_opencl_backend(const char* device_spec, size_t capacity) {
+    if (capacity == 0 || capacity > UINT32_MAX) {
+        printf("%s[ERROR] OpenCL backend supports pools of up to %u keypairs%s\n",
+            ANSI_COLOR_RED, UINT32_MAX, ANSI_COLOR_RESET);
+        return NULL;
+    }
+
+    cl_device_id device;
+    if (!pick_device(device_spec, &device)) {
+        return NULL;
+    }
+
+    ComputeBackend* backend = calloc(1, sizeof(ComputeBackend));
+    OpenCLBackend* cl = calloc(1, sizeof(OpenCLBackend));
+    if (!backend || !cl) {
+        free(backend);
+        free(cl);
+        return NULL;
+    }
+    backend->name = "opencl";
+    backend->upload = opencl_upload;
+    backend->search = opencl_search;
+    backend->destroy = opencl_destroy;
+    backend->impl = cl;
+    cl->capacity = capacity;
+
+    cl_int err;
+    cl->context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+    if (!cl_check(err, "context creation")) goto fail;
+    cl->queue = clCreateCommandQueue(cl->context, device, 0, &err);
+    if (!cl_check(err, "queue creation")) goto fail;
+
+    cl->program = clCreateProgramWithSource(cl->context, 1, &kernel_source, NULL, &err);
+    if (!cl_check(err, "program creation")) goto fail;
+    char options[64];
+    snprintf(options, sizeof(options), "-DMAX_REST_BLOCKS=%d", SHA256_MAX_TAIL_BLOCKS - 1);
+    err = clBuildProgram(cl->program, 1, &device, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        char log[4096] = {0};
+        clGetProgramBuildInfo(cl->program, device, CL_PROGRAM_BUILD_LOG, sizeof(log) - 1, log, NULL);
+        printf("%s[ERROR] OpenCL kernel build failed (%d):\n%s%s\n", ANSI_COLOR_RED, (int)err, log, ANSI_COLOR_RESET);
+        goto fail;
+    }
+    cl->kernel = clCreateKernel(cl->program, "search", &err);
+    if (!cl_check(err, "kernel creation")) goto fail;
+
+    cl->midstates = clCreateBuffer(cl->context, CL_MEM_READ_ONLY, capacity * 8 * sizeof(uint32_t), NULL, &err);
+    if (!cl_check(err, "midstate buffer")) goto fail;
+    cl->last_bytes = clCreateBuffer(cl->context, CL_MEM_READ_ONLY, capacity, NULL, &err);
+    if (!cl_check(err, "pubkey byte buffer")) goto fail;
+    cl->job = clCreateBuffer(cl->context, CL_MEM_READ_ONLY, sizeof(OpenCLJob), NULL, &err);
+    if (!cl_check(err, "job buffer")) goto fail;
+    cl->hits = clCreateBuffer(cl->context, CL_MEM_WRITE_ONLY, OPENCL_MAX_HITS * sizeof(uint32_t), NULL, &err);
+    if (!cl_check(err, "hit buffer")) goto fail;
+    cl->hit_count = clCreateBuffer(cl->context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &err);
+    if (!cl_check(err, "hit count buffer")) goto fail;
+
+    cl->staging = malloc(UPLOAD_CHUNK * sizeof(uint32_t));
+    cl->staging_last = malloc(UPLOAD_CHUNK);
+    if (!cl->staging || !cl->staging_last) goto fail;
+
+    return backend;
+
+fail:
+    opencl_destroy(backend);
+    return NULL;
+}
+
+#else
+
+ComputeBackend* create_opencl_backend(const char* device, size_t capacity) {
+    (void)device;
+    (void)capacity;
+    printf("%s[ERROR] OpenCL support not compiled in, rebuild with make OPENCL=1%s\n",
+        ANSI_COLOR_RED, ANSI_COLOR_RESET);
+    return NULL;
+}
+
+#endif // CMINER_OPENCL
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../include/miner.h"
+#include "../include/checkpoint.h"
+#include "../include/simd.h"
+
+#define CHECKPOINT_HEADER "# cminer checkpoint v1\n"
+#define CHECKPOINT_LINE_SIZE 1024
+#define CHECKPOINT_MAX_SEEDS 16
+
+typedef struct {
+    uint8_t base_key[32];
+    size_t capacity;
+    size_t position;            // Cursor to resume from, below capacity
+    uint64_t hashed;            // Candidates hashed against the seed so far
+    char seed[MAX_SEED_LEN + 1];
+} CheckpointEntry;
+
+static char* g_path = NULL;
+static CheckpointEntry g_entries[CHECKPOINT_MAX_SEEDS];  // Most recent first
+static int g_count = 0;
+
+static char g_seed[MAX_SEED_LEN + 1];  // Seed of the current job
+static bool g_have_seed = false;
+static bool g_active = false;          // g_entries[0] is the current seed on this pool
+static bool g_counting = false;        // Pool is full and mining started from the entry
+static size_t g_start_cursor;
+static uint64_t g_start_hashed;
+
+static pthread_mutex_t g_checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_save_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void load_checkpoints(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return;
+
+    char line[CHECKPOINT_LINE_SIZE];
+    while (fgets(line, sizeof(line), fp) && g_count < CHECKPOINT_MAX_SEEDS) {
+        if (line[0] == '#') continue;
+
+        CheckpointEntry* entry = &g_entries[g_count];
+        char base_hex[65] = "";
+        int seed_offset = 0;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (sscanf(line, "%64s %zu %zu %" SCNu64 " %n", base_hex, &entry->capacity, &entry->position,
+                   &entry->hashed, &seed_offset) != 4 ||
+            seed_offset == 0 || strlen(base_hex) != 64 || !hex_decode_simd(entry->base_key, base_hex, 32) ||
+            entry->capacity == 0 || entry->position >= entry->capacity ||
+            strlen(line + seed_offset) > MAX_SEED_LEN) {
+            continue;
+        }
+        strcpy(entry->seed, line + seed_offset);
+        g_count++;
+    }
+    fclose(fp);
+}
+
+// Find or add the entry for the current seed on this pool and move it to the
+// front, with g_checkpoint_mutex held
+static void bind_seed(void) {
+    uint8_t base_key[32];
+    size_t capacity;
+    if (!g_have_seed || !mining_pool_base(base_key, &capacity)) {
+        return;
+    }
+
+    int found = -1;
+    for (int i = 0; i < g_count && found < 0; i++) {
+        if (memcmp(g_entries[i].base_key, base_key, 32) == 0 && g_entries[i].capacity == capacity &&
+            strcmp(g_entries[i].seed, g_seed) == 0) {
+            found = i;
+        }
+    }
+
+    CheckpointEntry entry;
+    if (found >= 0) {
+        entry = g_entries[found];
+        memmove(&g_entries[1], &g_entries[0], found * sizeof(CheckpointEntry));
+        printf("%s[INFO] Resuming seed at pool position %zu, %" PRIu64 " candidates already hashed%s\n",
+            ANSI_COLOR_BLUE, entry.position, entry.hashed, ANSI_COLOR_RESET);
+        if (entry.hashed >= capacity) {
+            printf("%s[WARN] Every key in the pool was already hashed against this seed%s\n",
+                ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+        }
+    } else {
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.base_key, base_key, 32);
+        entry.capacity = capacity;
+        entry.position = mining_pool_cursor() % capacity;
+        strcpy(entry.seed, g_seed);
+        int keep = g_count < CHECKPOINT_MAX_SEEDS ? g_count : CHECKPOINT_MAX_SEEDS - 1;
+        memmove(&g_entries[1], &g_entries[0], keep * sizeof(CheckpointEntry));
+        g_count = keep + 1;
+    }
+    g_entries[0] = entry;
+    g_active = true;
+    g_counting = false;
+}
+
+// Bring the current seed's entry up to date, with g_checkpoint_mutex held
+static void track_progress(void) {
+    uint8_t base_key[32];
+    size_t capacity;
+    if (g_active && (!mining_pool_base(base_key, &capacity) ||
+                     memcmp(g_entries[0].base_key, base_key, 32) != 0 || g_entries[0].capacity != capacity)) {
+        g_active = false;  // A coordinator assigned a new range
+    }
+    if (!g_active) {
+        bind_seed();
+        if (!g_active) return;
+    }
+
+    // While the pool fills, mining wraps over the part generated so far and
+    // positions don't name fixed keys yet
+    size_t size, pool_capacity, cursor;
+    get_keypair_pool_stats(&size, &pool_capacity, &cursor);
+    if (size < pool_capacity) {
+        return;
+    }
+
+    CheckpointEntry* entry = &g_entries[0];
+    if (!g_counting) {
+        set_mining_pool_cursor(entry->position);
+        g_start_cursor = entry->position;
+        g_start_hashed = entry->hashed;
+        g_counting = true;
+        return;
+    }
+
+    // Claims that may not be hashed yet count as not done
+    size_t progress = mining_pool_cursor() - g_start_cursor;
+    size_t in_flight = mining_pool_in_flight();
+    size_t done = progress > in_flight ? progress - in_flight : 0;
+    entry->position = (g_start_cursor + done) % entry->capacity;
+    entry->hashed = g_start_hashed + done;
+}
+
+void checkpoint_job_started(const char* seed) {
+    pthread_mutex_lock(&g_checkpoint_mutex);
+    if (g_path) {
+        if (g_active && g_counting) {
+            track_progress();  // Final count for the previous seed
+        }
+        snprintf(g_seed, sizeof(g_seed), "%s", seed);
+        g_have_seed = true;
+        g_active = false;
+        track_progress();
+    }
+    pthread_mutex_unlock(&g_checkpoint_mutex);
+}
+
+void save_checkpoint(void) {
+    CheckpointEntry entries[CHECKPOINT_MAX_SEEDS];
+
+    pthread_mutex_lock(&g_checkpoint_mutex);
+    if (g_active && g_counting) {
+        track_progress();
+    }
+    int count = g_count;
+    memcpy(entries, g_entries, count * sizeof(CheckpointEntry));
+    const char* path = g_path;
+    pthread_mutex_unlock(&g_checkpoint_mutex);
+
+    if (!path || count == 0) {
+        return;
+    }
+
+    // Write a new file and rename it over the old one, a crash mid-write
+    // leaves the previous checkpoint
+    pthread_mutex_lock(&g_save_mutex);
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* fp = fopen(tmp_path, "w");
+    bool ok = fp != NULL;
+    if (fp) {
+        fputs(CHECKPOINT_HEADER, fp);
+        for (int i = 0; i < count; i++) {
+            char base_hex[65];
+            hex_encode_simd(base_hex, entries[i].base_key, 32);
+            base_hex[64] = '\0';
+            fprintf(fp, "%s %zu %zu %" PRIu64 " %s\n", base_hex, entries[i].capacity,
+                entries[i].position, entries[i].hashed, entries[i].seed);
+        }
+        ok = fclose(fp) == 0 && rename(tmp_path, path) == 0;
+    }
+    if (!ok) {
+        printf("%s[WARN] Cannot write checkpoint %s%s\n", ANSI_COLOR_YELLOW, path, ANSI_COLOR_RESET);
+    }
+    pthread_mutex_unlock(&g_save_mutex);
+}
+
+static void* checkpoint_thread(void* arg) {
+    int interval = (int)(intptr_t)arg;
+    int elapsed = 0;
+
+    while (1) {
+        sleep(1);
+
+        // Picks up the pool filling up or a coordinator range arriving
+        pthread_mutex_lock(&g_checkpoint_mutex);
+        track_progress();
+        pthread_mutex_unlock(&g_checkpoint_mutex);
+
+        if (interval > 0 && ++elapsed >= interval) {
+            elapsed = 0;
+            save_checkpoint();
+        }
+    }
+
+    return NULL;
+}
+
+bool start_checkpoints(const char* path, int interval) {
+    if (!path || strlen(path) == 0) {
+        return true;
+    }
+
+    pthread_mutex_lock(&g_checkpoint_mutex);
+    g_path = strdup(path);
+    load_checkpoints(path);
+    pthread_mutex_unlock(&g_checkpoint_mutex);
+    if (!g_path) {
+        return false;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, checkpoint_thread, (void*)(intptr_t)interval) != 0) {
+        return false;
+    }
+    pthread_detach(thread);
+
+    printf("%s[INFO] Checkpointing pool progress to %s%s\n", ANSI_COLOR_BLUE, path, ANSI_COLOR_RESET);
+    return true;
+}
@@ -35,6 +35,39 @@ static char* get_value(const char* line) {
     return value;
 }
 
+// Parse a byte count with an optional K/M/G suffix ("512M", "2G", "1048576")
+static size_t parse_size(const char* value) {
+    char* end;
+    double amount = strtod(value, &end);
+    while (isspace((unsigned char)*end)) end++;
+    switch (toupper((unsigned char)*end)) {
+        case 'G': amount *= 1024.0 * 1024 * 1024; break;
+        case 'M': amount *= 1024.0 * 1024; break;
+        case 'K': amount *= 1024.0; break;
+        default: break;
+    }
+    return amount > 0 ? (size_t)amount : 0;
+}
+
+static PoolBacking parse_pool_backing(const char* value) {
+    if (strcmp(value, "mmap") == 0) return POOL_BACKING_MMAP;
+    if (strcmp(value, "hugepages") == 0) return POOL_BACKING_HUGEPAGES;
+    if (strcmp(value, "shm") == 0) return POOL_BACKING_SHM;
+    if (strcmp(value, "heap") != 0) {
+        printf("[WARN] Unknown pool_backing \"%s\", using heap\n", value);
+    }
+    return POOL_BACKING_HEAP;
+}
+
+static const char* pool_backing_name(PoolBacking backing) {
+    switch (backing) {
+        case POOL_BACKING_MMAP: return "mmap";
+        case POOL_BACKING_HUGEPAGES: return "hugepages";
+        case POOL_BACKING_SHM: return "shm";
+        default: return "heap";
+    }
+}
+
 MinerConfig* load_config(const char* config_file) {
     FILE* fp = fopen(config_file, "r");
     if (!fp) {
@@ -51,6 +84,29 @@ MinerConfig* load_config(const char* config_file) {
         config->reporting.report_server = strdup("https://clc.ix.tc:3000");
         config->reporting.report_user = strdup("");
         config->pool_secret = strdup("");
+        config->metrics_listen = strdup("");
+        config->pool_refresh = false;
+        config->pool_memory = 1ULL * 1024 * 1024 * 1024;
+        config->generator_threads = -1;
+        config->pool_backing = POOL_BACKING_HEAP;
+        config->pool_shm_name = strdup("/cminer-pool");
+        config->compute_backend = strdup("cpu");
+        config->opencl_device = strdup("0:0");
+        config->opencl_batch = 1 << 20;
+        config->coordinator_listen = strdup("");
+        config->coordinator = strdup("");
+        config->worker_name = strdup("");
+        config->job_record = strdup("");
+        config->job_replay = strdup("");
+        config->replay_speed = 1.0;
+        config->pool_seed = strdup("");
+        config->control_listen = strdup("");
+        config->server_check_interval = 5;
+        config->autotune = false;
+        config->autotune_cache = strdup("cminer-tune.cache");
+        config->checkpoint_file = strdup("cminer.checkpoint");
+        config->checkpoint_interval = 30;
+        config->job_log = strdup("");
         
         return config;
     }
@@ -71,6 +127,29 @@ MinerConfig* load_config(const char* config_file) {
     config->reporting.report_server = strdup("https://clc.ix.tc:3000");
     config->reporting.report_user = strdup("");
     config->pool_secret = strdup("");
+    config->metrics_listen = strdup("");
+    config->pool_refresh = false;
+    config->pool_memory = 1ULL * 1024 * 1024 * 1024;
+    config->generator_threads = -1;
+    config->pool_backing = POOL_BACKING_HEAP;
+    config->pool_shm_name = strdup("/cminer-pool");
+    config->compute_backend = strdup("cpu");
+    config->opencl_device = strdup("0:0");
+    config->opencl_batch = 1 << 20;
+    config->coordinator_listen = strdup("");
+    config->coordinator = strdup("");
+    config->worker_name = strdup("");
+    config->job_record = strdup("");
+    config->job_replay = strdup("");
+    config->replay_speed = 1.0;
+    config->pool_seed = strdup("");
+    config->control_listen = strdup("");
+    config->server_check_interval = 5;
+    config->autotune = false;
+    config->autotune_cache = strdup("cminer-tune.cache");
+    config->checkpoint_file = strdup("cminer.checkpoint");
+    config->checkpoint_interval = 30;
+    config->job_log = strdup("");
 
     char line[MAX_LINE_LENGTH];
     while (fgets(line, sizeof(line), fp)) {
@@ -111,6 +190,92 @@ MinerConfig* load_config(const char* config_file) {
             free(config->pool_secret);
             config->pool_secret = strdup(get_value(trimmed));
         }
+        else if (strncmp(trimmed, "pool_refresh =", 14) == 0) {
+            config->pool_refresh = strcmp(get_value(trimmed), "true") == 0;
+        }
+        else if (strncmp(trimmed, "pool_memory =", 13) == 0) {
+            config->pool_memory = parse_size(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "generator_threads =", 19) == 0) {
+            config->generator_threads = atoi(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "pool_backing =", 14) == 0) {
+            config->pool_backing = parse_pool_backing(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "pool_shm_name =", 15) == 0) {
+            free(config->pool_shm_name);
+            config->pool_shm_name = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "compute_backend =", 17) == 0) {
+            free(config->compute_backend);
+            config->compute_backend = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "opencl_device =", 15) == 0) {
+            free(config->opencl_device);
+            config->opencl_device = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "opencl_batch =", 14) == 0) {
+            config->opencl_batch = strtoull(get_value(trimmed), NULL, 10);
+            if (config->opencl_batch == 0) {
+                config->opencl_batch = 1 << 20;
+            }
+        }
+        else if (strncmp(trimmed, "coordinator_listen =", 20) == 0) {
+            free(config->coordinator_listen);
+            config->coordinator_listen = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "coordinator =", 13) == 0) {
+            free(config->coordinator);
+            config->coordinator = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "worker_name =", 13) == 0) {
+            free(config->worker_name);
+            config->worker_name = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "job_record =", 12) == 0) {
+            free(config->job_record);
+            config->job_record = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "job_replay =", 12) == 0) {
+            free(config->job_replay);
+            config->job_replay = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "replay_speed =", 14) == 0) {
+            config->replay_speed = atof(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "pool_seed =", 11) == 0) {
+            free(config->pool_seed);
+            config->pool_seed = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "control_listen =", 16) == 0) {
+            free(config->control_listen);
+            config->control_listen = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "autotune =", 10) == 0) {
+            config->autotune = strcmp(get_value(trimmed), "true") == 0;
+        }
+        else if (strncmp(trimmed, "autotune_cache =", 16) == 0) {
+            free(config->autotune_cache);
+            config->autotune_cache = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "checkpoint_file =", 17) == 0) {
+            free(config->checkpoint_file);
+            config->checkpoint_file = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "job_log =", 9) == 0) {
+            free(config->job_log);
+            config->job_log = strdup(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "checkpoint_interval =", 21) == 0) {
+            config->checkpoint_interval = atoi(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "server_check_interval =", 23) == 0) {
+            config->server_check_interval = atoi(get_value(trimmed));
+        }
+        else if (strncmp(trimmed, "metrics_listen =", 16) == 0) {
+            free(config->metrics_listen);
+            config->metrics_listen = strdup(get_value(trimmed));
+        }
     }
 
     // 打印所有配置项
@@ -124,6 +289,29 @@ MinerConfig* load_config(const char* config_file) {
     printf("report_server = %s\n", config->reporting.report_server);
     printf("report_user = %s\n", config->reporting.report_user);
     printf("pool_secret = %s\n", config->pool_secret);
+    printf("metrics_listen = %s\n", config->metrics_listen);
+    printf("pool_refresh = %s\n", config->pool_refresh ? "true" : "false");
+    printf("pool_memory = %zu\n", config->pool_memory);
+    printf("generator_threads = %d\n", config->generator_threads);
+    printf("pool_backing = %s\n", pool_backing_name(config->pool_backing));
+    printf("pool_shm_name = %s\n", config->pool_shm_name);
+    printf("compute_backend = %s\n", config->compute_backend);
+    printf("opencl_device = %s\n", config->opencl_device);
+    printf("opencl_batch = %zu\n", config->opencl_batch);
+    printf("coordinator_listen = %s\n", config->coordinator_listen);
+    printf("coordinator = %s\n", config->coordinator);
+    printf("worker_name = %s\n", config->worker_name);
+    printf("job_record = %s\n", config->job_record);
+    printf("job_replay = %s\n", config->job_replay);
+    printf("replay_speed = %.2f\n", config->replay_speed);
+    printf("pool_seed = %s\n", config->pool_seed);
+    printf("control_listen = %s\n", config->control_listen);
+    printf("server_check_interval = %d\n", config->server_check_interval);
+    printf("autotune = %s\n", config->autotune ? "true" : "false");
+    printf("autotune_cache = %s\n", config->autotune_cache);
+    printf("checkpoint_file = %s\n", config->checkpoint_file);
+    printf("checkpoint_interval = %d\n", config->checkpoint_interval);
+    printf("job_log = %s\n", config->job_log);
 
 
     fclose(fp);
@@ -139,5 +327,19 @@ void free_config(MinerConfig* config) {
     free(config->reporting.report_server);
     free(config->reporting.report_user);
     free(config->pool_secret);
+    free(config->metrics_listen);
+    free(config->pool_shm_name);
+    free(config->compute_backend);
+    free(config->opencl_device);
+    free(config->coordinator_listen);
+    free(config->coordinator);
+    free(config->worker_name);
+    free(config->job_record);
+    free(config->job_replay);
+    free(config->pool_seed);
+    free(config->control_listen);
+    free(config->autotune_cache);
+    free(config->checkpoint_file);
+    free(config->job_log);
     free(config);
 }
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "../include/miner.h"
+#include "../include/control.h"
+
+#define CONTROL_LINE_SIZE 256
+#define CONTROL_REPLY_SIZE 1024
+
+typedef struct {
+    int listen_fd;
+    ControlHandler handler;
+    void* ctx;
+} ControlServer;
+
+static ControlServer g_control;
+
+// Answer every command line of one client until it disconnects
+static void serve_client(int fd) {
+    char buf[CONTROL_LINE_SIZE];
+    char reply[CONTROL_REPLY_SIZE];
+    size_t len = 0;
+
+    while (1) {
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0) return;
+        len += (size_t)n;
+        buf[len] = '\0';
+
+        char* line = buf;
+        char* end;
+        while ((end = strchr(line, '\n')) != NULL) {
+            *end = '\0';
+            if (end > line && end[-1] == '\r') end[-1] = '\0';
+            if (line[0] != '\0') {
+                g_control.handler(g_control.ctx, line, reply, sizeof(reply) - 1);
+                strcat(reply, "\n");
+                if (!send_all(fd, reply, strlen(reply))) return;
+            }
+            line = end + 1;
+        }
+
+        len = strlen(line);
+        if (len == sizeof(buf) - 1) {
+            static const char too_long[] = "ERROR command too long\n";
+            send_all(fd, too_long, sizeof(too_long) - 1);
+            return;
+        }
+        memmove(buf, line, len);
+    }
+}
+
+static void* control_thread(void* arg) {
+    (void)arg;
+    struct timeval timeout = {30, 0};
+
+    while (1) {
+        int fd = accept(g_control.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            // Out of descriptors: wait for some to be closed instead of spinning
+            if (errno != EINTR) usleep(100000);
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve_client(fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+bool start_control_server(const char* listen_addr, ControlHandler handler, void* ctx) {
+    if (!listen_addr || strlen(listen_addr) == 0) {
+        return true;
+    }
+
+    g_control.listen_fd = open_listener(listen_addr);
+    if (g_control.listen_fd < 0) {
+        printf("%s[ERROR] Failed to listen for control commands on %s%s\n", ANSI_COLOR_RED, listen_addr, ANSI_COLOR_RESET);
+        return false;
+    }
+    g_control.handler = handler;
+    g_control.ctx = ctx;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, control_thread, NULL) != 0) {
+        close(g_control.listen_fd);
+        return false;
+    }
+    pthread_detach(thread);
+
+    printf("%s[INFO] Control socket on %s%s\n", ANSI_COLOR_BLUE, listen_addr, ANSI_COLOR_RESET);
+    return true;
+}
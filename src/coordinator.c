@@ -0,0 +1,610 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <openssl/rand.h>
+#include <secp256k1.h>
+#include "../include/miner.h"
+#include "../include/coordinator.h"
+#include "../include/metrics.h"
+#include "../include/simd.h"
+
+#define COORDINATOR_MAX_WORKERS 1024
+#define COORDINATOR_LINE_SIZE 1024
+
+// Seconds between hashrate updates from a worker
+#define RATE_INTERVAL 5
+
+// Seconds before a worker retries a lost coordinator connection
+#define RECONNECT_DELAY 5
+
+typedef struct WorkerSlot WorkerSlot;
+
+// A range this coordinator handed out, and the worker mining it now
+typedef struct {
+    uint8_t base[32];
+    uint64_t count;
+    WorkerSlot* holder;   // NULL once its worker disconnected
+    bool own;             // The coordinator's own pool
+} AssignedRange;
+
+struct WorkerSlot {
+    bool in_use;
+    int fd;
+    pthread_mutex_t write_mutex;
+    char name[64];
+    uint64_t last_total;
+    uint64_t last_ns;
+    double hashrate;
+};
+
+static CoordinatorHandlers g_handlers;
+static secp256k1_context* g_ctx = NULL;
+
+// Coordinator state
+static WorkerSlot g_workers[COORDINATOR_MAX_WORKERS];
+static pthread_mutex_t g_workers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t g_master_key[32];
+static uint64_t g_next_offset = 0;
+static AssignedRange* g_ranges = NULL;
+static size_t g_range_count = 0;
+static size_t g_range_capacity = 0;
+static pthread_mutex_t g_range_mutex = PTHREAD_MUTEX_INITIALIZER;  // Guards the offset and g_ranges
+static Job g_job;                   // Latest job, kept to verify relayed solutions
+static bool g_have_job = false;
+static char g_job_line[COORDINATOR_LINE_SIZE];
+static pthread_mutex_t g_job_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Worker state
+static const MinerConfig* g_worker_config = NULL;
+static int g_coordinator_fd = -1;
+static pthread_mutex_t g_coordinator_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool g_have_range = false;
+static uint8_t g_range_base[32];
+
+static void strip_newline(char* line) {
+    line[strcspn(line, "\r\n")] = '\0';
+}
+
+// Next unassigned range of `count` keys after the master key, recorded as
+// held by holder (NULL for the coordinator's own pool)
+static bool allocate_range(size_t count, WorkerSlot* holder, uint8_t base[32]) {
+    uint8_t tweak[32] = {0};
+    bool ok = false;
+
+    pthread_mutex_lock(&g_range_mutex);
+    if (g_range_count == g_range_capacity) {
+        size_t capacity = g_range_capacity ? g_range_capacity * 2 : 64;
+        AssignedRange* ranges = realloc(g_ranges, capacity * sizeof(AssignedRange));
+        if (!ranges) {
+            pthread_mutex_unlock(&g_range_mutex);
+            return false;
+        }
+        g_ranges = ranges;
+        g_range_capacity = capacity;
+    }
+
+    uint64_t offset = g_next_offset;
+    memcpy(base, g_master_key, 32);
+    for (int i = 0; i < 8; i++) {
+        tweak[31 - i] = (uint8_t)(offset >> (i * 8));
+    }
+    if (offset == 0 || secp256k1_ec_seckey_tweak_add(g_ctx, base, tweak)) {
+        AssignedRange* range = &g_ranges[g_range_count++];
+        memcpy(range->base, base, 32);
+        range->count = count;
+        range->holder = holder;
+        range->own = holder == NULL;
+        g_next_offset += count;
+        ok = true;
+    }
+    pthread_mutex_unlock(&g_range_mutex);
+    return ok;
+}
+
+// A reconnecting worker keeps its range only if this coordinator handed it
+// out and nobody else is mining it. Anything else, e.g. a range from before a
+// coordinator restart, could overlap another worker's.
+static bool reclaim_range(const uint8_t base[32], uint64_t count, WorkerSlot* holder) {
+    bool ok = false;
+    pthread_mutex_lock(&g_range_mutex);
+    for (size_t i = 0; i < g_range_count && !ok; i++) {
+        AssignedRange* range = &g_ranges[i];
+        if (!range->own && range->holder == NULL && range->count == count && memcmp(range->base, base, 32) == 0) {
+            range->holder = holder;
+            ok = true;
+        }
+    }
+    pthread_mutex_unlock(&g_range_mutex);
+    return ok;
+}
+
+static void release_ranges(WorkerSlot* holder) {
+    pthread_mutex_lock(&g_range_mutex);
+    for (size_t i = 0; i < g_range_count; i++) {
+        if (g_ranges[i].holder == holder) {
+            g_ranges[i].holder = NULL;
+        }
+    }
+    pthread_mutex_unlock(&g_range_mutex);
+}
+
+static void send_line(WorkerSlot* worker, const char* line) {
+    pthread_mutex_lock(&worker->write_mutex);
+    send_all(worker->fd, line, strlen(line));
+    pthread_mutex_unlock(&worker->write_mutex);
+}
+
+// Check a relayed candidate against the current job and turn it into a solution
+static const char* verify_relayed(const char* private_hex, const char* hash_hex, Solution* solution) {
+    uint8_t private_key[32];
+    uint8_t claimed[32];
+    if (strlen(private_hex) != 64 || strlen(hash_hex) != 64 ||
+        !hex_decode_simd(private_key, private_hex, 32) || !hex_decode_simd(claimed, hash_hex, 32)) {
+        return "rejected";
+    }
+
+    secp256k1_pubkey pub;
+    size_t len = 65;
+    if (!secp256k1_ec_pubkey_create(g_ctx, &pub, private_key) ||
+        !secp256k1_ec_pubkey_serialize(g_ctx, solution->public_key, &len, &pub, SECP256K1_EC_UNCOMPRESSED)) {
+        return "rejected";
+    }
+
+    uint32_t midstate[8];
+    uint32_t digest[8];
+    uint8_t hash[32];
+    sha256_pubkey_midstate(midstate, solution->public_key);
+
+    pthread_mutex_lock(&g_job_mutex);
+    if (!g_have_job) {
+        pthread_mutex_unlock(&g_job_mutex);
+        return "stale";
+    }
+    sha256_tail_final(&g_job.tail, midstate, solution->public_key[64], digest);
+    sha256_state_to_bytes(digest, hash);
+    // A hash for another seed means the worker was still on an older job
+    bool current = memcmp(hash, claimed, 32) == 0;
+    bool meets = compare_hash_simd(hash, g_job.diff) <= 0;
+    solution->reward = g_job.reward;
+    solution->server = g_job.server;
+    pthread_mutex_unlock(&g_job_mutex);
+
+    if (!current) return "stale";
+    if (!meets) return "rejected";
+
+    memcpy(solution->private_key, private_key, 32);
+    solution->hash = strdup(hash_hex);
+    return solution->hash ? NULL : "rejected";
+}
+
+static void handle_hello(WorkerSlot* worker, char* args) {
+    char name[64] = "";
+    char base_hex[65] = "";
+    unsigned long long capacity = 0;
+    char line[COORDINATOR_LINE_SIZE];
+
+    int fields = sscanf(args, "%63s %llu %64s", name, &capacity, base_hex);
+    if (fields < 2 || capacity == 0 || worker->name[0]) {
+        send_line(worker, "ERROR bad HELLO\n");
+        return;
+    }
+    strcpy(worker->name, name);
+
+    uint8_t base[32];
+    bool reclaimed = fields == 3 && strlen(base_hex) == 64 && hex_decode_simd(base, base_hex, 32) &&
+                     reclaim_range(base, capacity, worker);
+    if (reclaimed) {
+        printf("%s[INFO] Worker %s reconnected with its range%s\n", ANSI_COLOR_BLUE, name, ANSI_COLOR_RESET);
+    } else {
+        if (fields == 3) {
+            printf("%s[WARN] Worker %s claimed a range that is not its to keep, assigning a new one%s\n",
+                ANSI_COLOR_YELLOW, name, ANSI_COLOR_RESET);
+        }
+        if (!allocate_range(capacity, worker, base)) {
+            send_line(worker, "ERROR keyspace exhausted\n");
+            return;
+        }
+        char hex[65];
+        hex_encode_simd(hex, base, 32);
+        hex[64] = '\0';
+        snprintf(line, sizeof(line), "RANGE %s %llu\n", hex, capacity);
+        send_line(worker, line);
+        printf("%s[INFO] Worker %s joined, assigned %llu keys%s\n", ANSI_COLOR_BLUE, name, capacity, ANSI_COLOR_RESET);
+    }
+
+    pthread_mutex_lock(&g_job_mutex);
+    bool have_job = g_have_job;
+    if (have_job) {
+        strcpy(line, g_job_line);
+    }
+    pthread_mutex_unlock(&g_job_mutex);
+    if (have_job) {
+        send_line(worker, line);
+    }
+}
+
+static void handle_rate(WorkerSlot* worker, const char* args) {
+    uint64_t total = strtoull(args, NULL, 10);
+    uint64_t now = metrics_now_ns();
+
+    pthread_mutex_lock(&g_workers_mutex);
+    if (worker->last_ns && now > worker->last_ns && total >= worker->last_total) {
+        worker->hashrate = (double)(total - worker->last_total) * 1e9 / (now - worker->last_ns);
+    }
+    worker->last_total = total;
+    worker->last_ns = now;
+    pthread_mutex_unlock(&g_workers_mutex);
+}
+
+static void handle_solved(WorkerSlot* worker, const char* args) {
+    char private_hex[65] = "";
+    char hash_hex[65] = "";
+    char line[COORDINATOR_LINE_SIZE];
+    Solution solution = {0};
+
+    if (sscanf(args, "%64s %64s", private_hex, hash_hex) != 2) {
+        send_line(worker, "ERROR bad SOLVED\n");
+        return;
+    }
+
+    const char* outcome = verify_relayed(private_hex, hash_hex, &solution);
+    if (!outcome) {
+        printf("\n%s[INFO] Solution relayed by %s%s\n", ANSI_COLOR_GREEN, worker->name, ANSI_COLOR_RESET);
+        outcome = g_handlers.on_solution(g_handlers.ctx, &solution) ? "accepted" : "rejected";
+    }
+    free(solution.hash);
+
+    snprintf(line, sizeof(line), "RESULT %s %s\n", outcome, hash_hex);
+    send_line(worker, line);
+}
+
+static void* worker_connection_thread(void* arg) {
+    WorkerSlot* worker = (WorkerSlot*)arg;
+    char line[COORDINATOR_LINE_SIZE];
+
+    FILE* in = fdopen(dup(worker->fd), "r");
+    while (in && fgets(line, sizeof(line), in)) {
+        strip_newline(line);
+        if (strncmp(line, "HELLO ", 6) == 0) {
+            handle_hello(worker, line + 6);
+        } else if (strncmp(line, "RATE ", 5) == 0) {
+            handle_rate(worker, line + 5);
+        } else if (strncmp(line, "SOLVED ", 7) == 0) {
+            handle_solved(worker, line + 7);
+        }
+    }
+    if (in) {
+        fclose(in);
+    }
+
+    printf("%s[WARN] Worker %s disconnected%s\n", ANSI_COLOR_YELLOW,
+        worker->name[0] ? worker->name : "(unnamed)", ANSI_COLOR_RESET);
+    release_ranges(worker);
+
+    pthread_mutex_lock(&g_workers_mutex);
+    pthread_mutex_lock(&worker->write_mutex);
+    close(worker->fd);
+    worker->fd = -1;
+    worker->in_use = false;
+    pthread_mutex_unlock(&worker->write_mutex);
+    pthread_mutex_unlock(&g_workers_mutex);
+    return NULL;
+}
+
+static void* coordinator_accept_thread(void* arg) {
+    int listen_fd = (int)(intptr_t)arg;
+    struct timeval timeout = {5, 0};
+
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            // Out of descriptors: wait for some to be closed instead of spinning
+            if (errno != EINTR) usleep(100000);
+            continue;
+        }
+        // A stuck worker must not hold up job broadcasts for long
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        WorkerSlot* worker = NULL;
+        pthread_mutex_lock(&g_workers_mutex);
+        for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+            if (!g_workers[i].in_use) {
+                worker = &g_workers[i];
+                worker->in_use = true;
+                worker->fd = fd;
+                worker->name[0] = '\0';
+                worker->last_total = 0;
+                worker->last_ns = 0;
+                worker->hashrate = 0;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&g_workers_mutex);
+
+        pthread_t thread;
+        if (!worker) {
+            printf("%s[ERROR] Too many workers, refusing connection%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+            close(fd);
+        } else if (pthread_create(&thread, NULL, worker_connection_thread, worker) != 0) {
+            pthread_mutex_lock(&g_workers_mutex);
+            close(fd);
+            worker->in_use = false;
+            pthread_mutex_unlock(&g_workers_mutex);
+        } else {
+            pthread_detach(thread);
+        }
+    }
+
+    return NULL;
+}
+
+bool start_coordinator(const MinerConfig* config, const CoordinatorHandlers* handlers) {
+    g_handlers = *handlers;
+    g_ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+    if (!g_ctx) {
+        printf("Failed to create secp256k1 context\n");
+        return false;
+    }
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+        g_workers[i].fd = -1;
+        pthread_mutex_init(&g_workers[i].write_mutex, NULL);
+    }
+
+    // Ranges are offsets from a random master key, so separate coordinators
+    // don't collide either
+    do {
+        if (RAND_bytes(g_master_key, 32) != 1) {
+            printf("Failed to generate random bytes\n");
+            return false;
+        }
+    } while (!secp256k1_ec_seckey_verify(g_ctx, g_master_key));
+
+    // The coordinator mines the first range itself
+    uint8_t base[32];
+    if (!allocate_range(mining_pool_capacity(), NULL, base)) {
+        return false;
+    }
+    start_mining_pool(base);
+
+    int listen_fd = open_listener(config->coordinator_listen);
+    if (listen_fd < 0) {
+        printf("%s[ERROR] Failed to listen for workers on %s%s\n",
+            ANSI_COLOR_RED, config->coordinator_listen, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, coordinator_accept_thread, (void*)(intptr_t)listen_fd) != 0) {
+        close(listen_fd);
+        return false;
+    }
+    pthread_detach(thread);
+
+    printf("%s[INFO] Coordinating workers on %s%s\n", ANSI_COLOR_BLUE, config->coordinator_listen, ANSI_COLOR_RESET);
+    return true;
+}
+
+void coordinator_publish_job(const Job* job) {
+    char diff_hex[65];
+    char line[COORDINATOR_LINE_SIZE];
+    hex_encode_simd(diff_hex, job->diff, 32);
+    diff_hex[64] = '\0';
+    snprintf(line, sizeof(line), "JOB %s %.8f %" PRIu64 " %s\n", diff_hex, job->reward, job->last_found, job->seed);
+
+    pthread_mutex_lock(&g_job_mutex);
+    g_job = *job;
+    g_have_job = true;
+    strcpy(g_job_line, line);
+    pthread_mutex_unlock(&g_job_mutex);
+
+    pthread_mutex_lock(&g_workers_mutex);
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+        // Only workers that said HELLO have a range to mine
+        if (g_workers[i].in_use && g_workers[i].name[0]) {
+            send_line(&g_workers[i], line);
+        }
+    }
+    pthread_mutex_unlock(&g_workers_mutex);
+}
+
+void coordinator_stats(int* workers, double* hashrate) {
+    *workers = 0;
+    *hashrate = 0;
+    pthread_mutex_lock(&g_workers_mutex);
+    for (int i = 0; i < COORDINATOR_MAX_WORKERS; i++) {
+        if (g_workers[i].in_use && g_workers[i].name[0]) {
+            (*workers)++;
+            *hashrate += g_workers[i].hashrate;
+        }
+    }
+    pthread_mutex_unlock(&g_workers_mutex);
+}
+
+static void send_to_coordinator(const char* line) {
+    pthread_mutex_lock(&g_coordinator_mutex);
+    if (g_coordinator_fd >= 0) {
+        send_all(g_coordinator_fd, line, strlen(line));
+    }
+    pthread_mutex_unlock(&g_coordinator_mutex);
+}
+
+static void handle_range(const char* args) {
+    char base_hex[65] = "";
+    unsigned long long count = 0;
+    uint8_t base[32];
+
+    if (sscanf(args, "%64s %llu", base_hex, &count) != 2 || strlen(base_hex) != 64 ||
+        !hex_decode_simd(base, base_hex, 32)) {
+        printf("%s[ERROR] Bad range from coordinator%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        return;
+    }
+    if (count < mining_pool_capacity()) {
+        printf("%s[ERROR] Coordinator range of %llu keys is smaller than the pool%s\n",
+            ANSI_COLOR_RED, count, ANSI_COLOR_RESET);
+        return;
+    }
+
+    // A coordinator that didn't hand out the range we had (it restarted, or
+    // someone else holds it) assigns a new one; the pool is rebuilt from it
+    bool had_range = g_have_range;
+    memcpy(g_range_base, base, 32);
+    g_have_range = true;
+    printf("%s[INFO] Assigned keyspace range %s + %llu%s\n", ANSI_COLOR_BLUE, base_hex, count, ANSI_COLOR_RESET);
+    if (had_range) {
+        restart_mining_pool(base);
+    } else {
+        start_mining_pool(base);
+    }
+}
+
+static void handle_job(const char* args) {
+    char diff_hex[65] = "";
+    double reward = 0;
+    uint64_t last_found = 0;
+    int seed_offset = 0;
+
+    if (sscanf(args, "%64s %lf %" SCNu64 " %n", diff_hex, &reward, &last_found, &seed_offset) != 3 ||
+        seed_offset == 0 || strlen(diff_hex) != 64) {
+        printf("%s[ERROR] Bad job from coordinator%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        return;
+    }
+
+    // Jobs are only read on this thread, one slot does
+    static Job job;
+    const char* seed = args + seed_offset;
+    job.reward = reward;
+    job.last_found = last_found;
+    job.server = NULL;
+    if (!job_set_seed(&job, seed, strlen(seed)) || !job_set_diff(&job, diff_hex, 64)) {
+        printf("%s[ERROR] Bad job from coordinator%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        return;
+    }
+    g_handlers.on_job(g_handlers.ctx, &job);
+}
+
+static void handle_result(const char* args) {
+    if (strncmp(args, "accepted ", 9) == 0) {
+        printf("%s[INFO] Coordinator submitted %s%s\n", ANSI_COLOR_GREEN, args + 9, ANSI_COLOR_RESET);
+    } else {
+        printf("%s[WARN] Coordinator result: %s%s\n", ANSI_COLOR_YELLOW, args, ANSI_COLOR_RESET);
+    }
+}
+
+static void* worker_rate_thread(void* arg) {
+    (void)arg;
+    char line[64];
+
+    while (1) {
+        sleep(RATE_INTERVAL);
+        snprintf(line, sizeof(line), "RATE %" PRIu64 "\n", metrics_total_hashes());
+        send_to_coordinator(line);
+    }
+
+    return NULL;
+}
+
+static void* worker_client_thread(void* arg) {
+    (void)arg;
+    char name[64];
+    char line[COORDINATOR_LINE_SIZE];
+
+    if (g_worker_config->worker_name[0]) {
+        snprintf(name, sizeof(name), "%s", g_worker_config->worker_name);
+    } else {
+        // Hostname and pid tell apart several workers on one node
+        char host[48] = "worker";
+        gethostname(host, sizeof(host) - 1);
+        host[sizeof(host) - 1] = '\0';
+        snprintf(name, sizeof(name), "%s-%d", host, (int)getpid());
+    }
+
+    while (1) {
+        int fd = connect_socket(g_worker_config->coordinator);
+        if (fd < 0) {
+            printf("%s[WARN] Cannot reach coordinator %s, retrying in %ds%s\n",
+                ANSI_COLOR_YELLOW, g_worker_config->coordinator, RECONNECT_DELAY, ANSI_COLOR_RESET);
+            sleep(RECONNECT_DELAY);
+            continue;
+        }
+
+        pthread_mutex_lock(&g_coordinator_mutex);
+        g_coordinator_fd = fd;
+        pthread_mutex_unlock(&g_coordinator_mutex);
+
+        if (g_have_range) {
+            char base_hex[65];
+            hex_encode_simd(base_hex, g_range_base, 32);
+            base_hex[64] = '\0';
+            snprintf(line, sizeof(line), "HELLO %s %zu %s\n", name, mining_pool_capacity(), base_hex);
+        } else {
+            snprintf(line, sizeof(line), "HELLO %s %zu\n", name, mining_pool_capacity());
+        }
+        send_to_coordinator(line);
+        printf("%s[INFO] Connected to coordinator %s as %s%s\n",
+            ANSI_COLOR_BLUE, g_worker_config->coordinator, name, ANSI_COLOR_RESET);
+
+        FILE* in = fdopen(dup(fd), "r");
+        while (in && fgets(line, sizeof(line), in)) {
+            strip_newline(line);
+            if (strncmp(line, "RANGE ", 6) == 0) {
+                handle_range(line + 6);
+            } else if (strncmp(line, "JOB ", 4) == 0) {
+                handle_job(line + 4);
+            } else if (strncmp(line, "RESULT ", 7) == 0) {
+                handle_result(line + 7);
+            } else if (strncmp(line, "ERROR ", 6) == 0) {
+                printf("%s[ERROR] Coordinator: %s%s\n", ANSI_COLOR_RED, line + 6, ANSI_COLOR_RESET);
+            }
+        }
+        if (in) {
+            fclose(in);
+        }
+
+        pthread_mutex_lock(&g_coordinator_mutex);
+        close(g_coordinator_fd);
+        g_coordinator_fd = -1;
+        pthread_mutex_unlock(&g_coordinator_mutex);
+
+        // Keep mining the last job meanwhile, solutions found now are lost
+        printf("%s[WARN] Lost coordinator connection, reconnecting in %ds%s\n",
+            ANSI_COLOR_YELLOW, RECONNECT_DELAY, ANSI_COLOR_RESET);
+        sleep(RECONNECT_DELAY);
+    }
+
+    return NULL;
+}
+
+bool start_coordinator_worker(const MinerConfig* config, const CoordinatorHandlers* handlers) {
+    g_handlers = *handlers;
+    g_worker_config = config;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, worker_client_thread, NULL) != 0) {
+        return false;
+    }
+    pthread_detach(thread);
+    if (pthread_create(&thread, NULL, worker_rate_thread, NULL) != 0) {
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+bool coordinator_relay_solution(const Solution* solution) {
+    char private_hex[65];
+    char line[COORDINATOR_LINE_SIZE];
+    hex_encode_simd(private_hex, solution->private_key, 32);
+    private_hex[64] = '\0';
+    snprintf(line, sizeof(line), "SOLVED %s %s\n", private_hex, solution->hash);
+
+    pthread_mutex_lock(&g_coordinator_mutex);
+    bool sent = g_coordinator_fd >= 0 && send_all(g_coordinator_fd, line, strlen(line));
+    pthread_mutex_unlock(&g_coordinator_mutex);
+    return sent;
+}
@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include "../include/miner.h"
+
+// CPU quota from cgroup v2 (cpu.max) or v1 (cfs quota/period), in CPUs.
+// Returns 0 if there is no quota.
+static int get_cgroup_cpu_limit(void) {
+    long long quota = -1;
+    long long period = 0;
+
+    FILE* fp = fopen("/sys/fs/cgroup/cpu.max", "r");
+    if (fp) {
+        char max[32];
+        if (fscanf(fp, "%31s %lld", max, &period) == 2 && strcmp(max, "max") != 0) {
+            quota = atoll(max);
+        }
+        fclose(fp);
+    } else {
+        fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", "r");
+        if (fp) {
+            if (fscanf(fp, "%lld", &quota) != 1) quota = -1;
+            fclose(fp);
+        }
+        fp = fopen("/sys/fs/cgroup/cpu/cpu.cfs_period_us", "r");
+        if (fp) {
+            if (fscanf(fp, "%lld", &period) != 1) period = 0;
+            fclose(fp);
+        }
+    }
+
+    if (quota <= 0 || period <= 0) {
+        return 0;
+    }
+    return (int)((quota + period - 1) / period);
+}
+
+// CPUs this process may actually use: online CPUs, narrowed by the affinity
+// mask and by any cgroup CPU quota
+int get_available_cpus(void) {
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        int allowed = CPU_COUNT(&set);
+        if (allowed > 0 && allowed < cpus) cpus = allowed;
+    }
+
+    int limit = get_cgroup_cpu_limit();
+    if (limit > 0 && limit < cpus) {
+        cpus = limit;
+    }
+
+    return cpus > 0 ? cpus : 1;
+}
+
+void get_cpu_model(char* model, size_t size) {
+    snprintf(model, size, "unknown");
+
+    FILE* fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "model name", 10) == 0) {
+            char* value = strchr(line, ':');
+            if (value) {
+                value++;
+                while (*value == ' ' || *value == '\t') value++;
+                value[strcspn(value, "\n")] = '\0';
+                snprintf(model, size, "%s", value);
+            }
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+static int read_topology(int cpu, const char* name) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE* fp = fopen(path, "r");
+    if (!fp) return cpu;  // No topology, treat every CPU as its own core
+
+    int value = cpu;
+    if (fscanf(fp, "%d", &value) != 1) value = cpu;
+    fclose(fp);
+    return value;
+}
+
+typedef struct {
+    int cpu;
+    int package;
+    int core;
+    int sibling;  // Index among the hardware threads of its core
+} CpuTopology;
+
+static int compare_compact(const void* a, const void* b) {
+    const CpuTopology* x = a;
+    const CpuTopology* y = b;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+static int compare_spread(const void* a, const void* b) {
+    const CpuTopology* x = a;
+    const CpuTopology* y = b;
+    if (x->sibling != y->sibling) return x->sibling - y->sibling;
+    return compare_compact(a, b);
+}
+
+// Topology of every CPU in the affinity mask, returns the count
+static int read_cpu_topology(CpuTopology* topology) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        return 0;
+    }
+
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+        CpuTopology* t = &topology[count++];
+        t->cpu = cpu;
+        t->package = read_topology(cpu, "physical_package_id");
+        t->core = read_topology(cpu, "core_id");
+        t->sibling = 0;
+        for (int i = 0; i < count - 1; i++) {
+            if (topology[i].package == t->package && topology[i].core == t->core) {
+                t->sibling++;
+            }
+        }
+    }
+    return count;
+}
+
+int get_cpu_order(int* cpus, int max, bool spread) {
+    CpuTopology topology[CPU_SETSIZE];
+    int count = read_cpu_topology(topology);
+
+    qsort(topology, count, sizeof(CpuTopology), spread ? compare_spread : compare_compact);
+    for (int i = 0; i < count && i < max; i++) {
+        cpus[i] = topology[i].cpu;
+    }
+    return count < max ? count : max;
+}
+
+int get_physical_cores(void) {
+    CpuTopology topology[CPU_SETSIZE];
+    int count = read_cpu_topology(topology);
+
+    int cores = 0;
+    for (int i = 0; i < count; i++) {
+        if (topology[i].sibling == 0) cores++;
+    }
+    return cores > 0 ? cores : 1;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <openssl/bn.h>
+#include "../include/miner.h"
+#include "../include/metrics.h"
+#include "../include/joblog.h"
+#include "../include/keyset.h"
+#include "../include/simd.h"
+
+#define JOB_LOG_HEADER "start,seconds,hashes,candidates,hash_rate,expected_hashes,found,reward,best_hash,diff,node,seed\n"
+
+typedef struct {
+    bool active;
+    time_t start;
+    uint64_t start_ns;
+    uint64_t start_hashes;
+    uint8_t diff[32];
+    char expected[80];            // Decimal, 2^256 / (diff + 1) has at most 78 digits
+    char seed[MAX_SEED_LEN + 1];
+    int found;
+    double reward;
+} JobLogRecord;
+
+static FILE* g_job_log = NULL;
+static char g_node[64];
+static JobLogRecord g_current;
+// Solution hashes of the current job. A job that stays up while the pool
+// cycles finds the same solutions again.
+static KeySet g_found;
+static pthread_mutex_t g_job_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// A hash meets diff with probability (diff + 1) / 2^256
+static bool expected_hashes(const uint8_t diff[32], char* out, size_t size) {
+    BN_CTX* ctx = BN_CTX_new();
+    BIGNUM* space = BN_new();
+    BIGNUM* targets = BN_bin2bn(diff, 32, NULL);
+    BIGNUM* expected = BN_new();
+    char* dec = NULL;
+
+    bool ok = ctx && space && targets && expected &&
+              BN_set_word(space, 1) && BN_lshift(space, space, 256) &&
+              BN_add_word(targets, 1) && BN_div(expected, NULL, space, targets, ctx) &&
+              (dec = BN_bn2dec(expected)) != NULL && strlen(dec) < size;
+    if (ok) {
+        strcpy(out, dec);
+    }
+
+    OPENSSL_free(dec);
+    BN_free(expected);
+    BN_free(targets);
+    BN_free(space);
+    BN_CTX_free(ctx);
+    return ok;
+}
+
+bool job_log_open(const char* path, const char* node) {
+    struct stat st;
+    bool is_new = stat(path, &st) != 0 || st.st_size == 0;
+
+    g_job_log = fopen(path, "a");
+    if (!g_job_log) {
+        printf("%s[ERROR] Cannot open job log %s%s\n", ANSI_COLOR_RED, path, ANSI_COLOR_RESET);
+        return false;
+    }
+    if (is_new) {
+        fputs(JOB_LOG_HEADER, g_job_log);
+        fflush(g_job_log);
+    }
+    snprintf(g_node, sizeof(g_node), "%s", node);
+    // Commas would shift the columns
+    for (char* c = g_node; *c; c++) {
+        if (*c == ',') *c = '_';
+    }
+    printf("%s[INFO] Logging job accounting to %s%s\n", ANSI_COLOR_BLUE, path, ANSI_COLOR_RESET);
+    return true;
+}
+
+// Append the record of the current job, with g_job_log_mutex held
+static void write_record(const uint8_t best_hash[32]) {
+    if (!g_job_log || !g_current.active) {
+        return;
+    }
+
+    uint64_t hashes = metrics_total_hashes() - g_current.start_hashes;
+    // Mining wraps over the published part of the pool, which may still be filling
+    uint64_t candidates = hashes;
+    if (!mining_pool_refreshing() && candidates > mining_pool_size()) {
+        candidates = mining_pool_size();
+    }
+    double seconds = (metrics_now_ns() - g_current.start_ns) / 1e9;
+    char best_hex[65];
+    char diff_hex[65];
+    hex_encode_simd(best_hex, best_hash, 32);
+    best_hex[64] = '\0';
+    hex_encode_simd(diff_hex, g_current.diff, 32);
+    diff_hex[64] = '\0';
+
+    fprintf(g_job_log, "%lld,%.3f,%" PRIu64 ",%" PRIu64 ",%.0f,%s,%d,%.8f,%s,%s,%s,%s\n",
+        (long long)g_current.start, seconds, hashes, candidates, seconds > 0 ? hashes / seconds : 0.0,
+        g_current.expected, g_current.found, g_current.reward, best_hex, diff_hex, g_node, g_current.seed);
+    fflush(g_job_log);
+    g_current.active = false;
+}
+
+void job_log_switch(const Job* new_job, const uint8_t best_hash[32]) {
+    pthread_mutex_lock(&g_job_log_mutex);
+    if (g_job_log) {
+        write_record(best_hash);
+
+        memset(&g_current, 0, sizeof(g_current));
+        keyset_clear(&g_found);
+        if (expected_hashes(new_job->diff, g_current.expected, sizeof(g_current.expected))) {
+            g_current.active = true;
+            g_current.start = time(NULL);
+            g_current.start_ns = metrics_now_ns();
+            g_current.start_hashes = metrics_total_hashes();
+            memcpy(g_current.diff, new_job->diff, 32);
+            memcpy(g_current.seed, new_job->seed, new_job->seed_len + 1);
+        }
+    }
+    pthread_mutex_unlock(&g_job_log_mutex);
+}
+
+void job_log_solution(const Solution* solution) {
+    pthread_mutex_lock(&g_job_log_mutex);
+    if (g_current.active && solution->hash) {
+        // A hash that doesn't decode can't be compared, count it
+        uint8_t hash[32];
+        bool fresh = strlen(solution->hash) != 64 || !hex_decode_simd(hash, solution->hash, 32) ||
+                     keyset_insert(&g_found, hash);
+        if (fresh) {
+            g_current.found++;
+            g_current.reward += solution->reward;
+        }
+    }
+    pthread_mutex_unlock(&g_job_log_mutex);
+}
+
+void job_log_close(void) {
+    uint8_t best_hash[32];
+    pthread_mutex_lock(&g_hash_mutex);
+    memcpy(best_hash, g_best_hash, 32);
+    pthread_mutex_unlock(&g_hash_mutex);
+
+    pthread_mutex_lock(&g_job_log_mutex);
+    write_record(best_hash);
+    keyset_free(&g_found);
+    pthread_mutex_unlock(&g_job_log_mutex);
+}
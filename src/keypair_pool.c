@@ -2,258 +2,761 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <openssl/rand.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
 #include <secp256k1.h>
 #include "../include/miner.h"
 #include "../include/simd.h"
 
-// Global secp256k1 context for keypair generation
-static secp256k1_context* ctx = NULL;
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+// How often a process waiting on a shared pool's owner checks on it
+#define SHARED_POOL_POLL_US 100000
+// Pause before retrying a batch whose generation failed
+#define GEN_RETRY_US 100000
+
+// Random private keys come from a per-thread ChaCha20 keystream rather than a
+// RAND_bytes call per key, which has every generator thread take OpenSSL's
+// DRBG lock. Each refill encrypts a block under a single-use key and the first
+// 32 bytes of it become the next key (fast key erasure), and handed out keys
+// are wiped from the block, so a thread's state never reveals earlier keys.
+#define KEY_STREAM_BLOCK 4096
+// Refills between mixing fresh OS randomness into the key, 16 MiB of keys
+#define KEY_STREAM_RESEED 4096
 
-// Thread data structure for parallel keypair generation
 typedef struct {
-    KeypairPool* pool;
-    size_t start_index;
-    size_t count;
-    pthread_mutex_t* progress_mutex;
-    size_t* total_generated;
-    size_t total_to_generate;
-} ThreadGenData;
-
-// Create a new keypair pool with the specified capacity
-KeypairPool* create_keypair_pool(size_t capacity) {
-    KeypairPool* pool = (KeypairPool*)malloc(sizeof(KeypairPool));
+    EVP_CIPHER_CTX* cipher;
+    uint8_t key[32];
+    uint8_t block[KEY_STREAM_BLOCK];
+    size_t offset;
+    unsigned refills;
+} KeyStream;
+
+static __thread KeyStream t_key_stream;
+
+// Allocate the keypair array with the requested backing
+static Keypair* allocate_keypairs(KeypairPool* pool, size_t bytes) {
+    void* mem;
+
+    switch (pool->backing) {
+        case POOL_BACKING_HUGEPAGES:
+            pool->mapped_bytes = (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+            mem = mmap(NULL, pool->mapped_bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mem != MAP_FAILED) {
+                printf("Keypair pool backed by explicit huge pages\n");
+                return (Keypair*)mem;
+            }
+            // No reserved huge pages, ask for transparent ones instead
+            mem = mmap(NULL, pool->mapped_bytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED) return NULL;
+            if (madvise(mem, pool->mapped_bytes, MADV_HUGEPAGE) == 0) {
+                printf("Keypair pool backed by transparent huge pages\n");
+            }
+            return (Keypair*)mem;
+
+        case POOL_BACKING_MMAP:
+            pool->mapped_bytes = bytes;
+            mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return mem == MAP_FAILED ? NULL : (Keypair*)mem;
+
+        default:
+            return (Keypair*)malloc(bytes);
+    }
+}
+
+// Bytes of a shared segment: header, keypairs, then a refresh generation per batch
+static size_t shared_pool_bytes(size_t capacity) {
+    size_t batch_count = (capacity + GEN_BATCH_SIZE - 1) / GEN_BATCH_SIZE;
+    return SHARED_POOL_HEADER_SIZE + capacity * sizeof(Keypair) + batch_count * sizeof(uint32_t);
+}
+
+static void use_shared_pool(KeypairPool* pool, int fd, void* mem, size_t bytes) {
+    pool->shared = (SharedPoolHeader*)mem;
+    pool->shm_fd = fd;
+    pool->keypairs = (Keypair*)((uint8_t*)mem + SHARED_POOL_HEADER_SIZE);
+    pool->batch_generation = (_Atomic uint32_t*)(pool->keypairs + pool->shared->capacity);
+    pool->mapped_bytes = bytes;
+}
+
+// Create the shared segment and own it: the lock is taken before the header
+// is valid, so no attaching process can see the segment without an owner
+static bool create_shared_pool(KeypairPool* pool, int fd, const char* name, size_t capacity) {
+    size_t bytes = shared_pool_bytes(capacity);
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || ftruncate(fd, (off_t)bytes) != 0) {
+        printf("%s[ERROR] Cannot size shared pool %s: %s%s\n", ANSI_COLOR_RED, name, strerror(errno), ANSI_COLOR_RESET);
+        return false;
+    }
+    void* mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        printf("%s[ERROR] Cannot map shared pool %s: %s%s\n", ANSI_COLOR_RED, name, strerror(errno), ANSI_COLOR_RESET);
+        return false;
+    }
+
+    SharedPoolHeader* header = (SharedPoolHeader*)mem;
+    header->keypair_size = sizeof(Keypair);
+    header->capacity = capacity;
+    atomic_init(&header->size, 0);
+    atomic_init(&header->cursor, 0);
+    atomic_init(&header->owner_pid, (int32_t)getpid());
+    atomic_init(&header->keys, SHARED_KEYS_PENDING);
+    atomic_init(&header->refreshed_batches, 0);
+    // Attaching processes wait for the magic before trusting the rest
+    atomic_store_explicit(&header->magic, SHARED_POOL_MAGIC, memory_order_release);
+
+    use_shared_pool(pool, fd, mem, bytes);
+    pool->owner = true;
+    printf("Created shared keypair pool %s\n", name);
+    return true;
+}
+
+// Map an existing segment: the header read-write for the cursor, the rest
+// read-only until this process takes the fill over
+static bool attach_shared_pool(KeypairPool* pool, int fd, const char* name) {
+    SharedPoolHeader* header = MAP_FAILED;
+    uint32_t magic = 0;
+
+    // The creator may still be setting the segment up
+    for (int tries = 0; tries < 50 && header == MAP_FAILED; tries++) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= SHARED_POOL_HEADER_SIZE) {
+            header = mmap(NULL, SHARED_POOL_HEADER_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+            if (header != MAP_FAILED &&
+                (magic = atomic_load_explicit(&header->magic, memory_order_acquire)) == 0) {
+                munmap(header, SHARED_POOL_HEADER_SIZE);
+                header = MAP_FAILED;
+            }
+        }
+        if (header == MAP_FAILED) {
+            usleep(SHARED_POOL_POLL_US);
+        }
+    }
+    if (header == MAP_FAILED) {
+        printf("%s[ERROR] Shared pool %s was never initialized, remove /dev/shm%s to rebuild it%s\n",
+            ANSI_COLOR_RED, name, name, ANSI_COLOR_RESET);
+        return false;
+    }
+    size_t capacity = header->capacity;
+    if (magic != SHARED_POOL_MAGIC || header->keypair_size != sizeof(Keypair)) {
+        printf("%s[ERROR] Shared pool %s was created by an incompatible build%s\n", ANSI_COLOR_RED, name, ANSI_COLOR_RESET);
+        munmap(header, SHARED_POOL_HEADER_SIZE);
+        return false;
+    }
+    munmap(header, SHARED_POOL_HEADER_SIZE);
+
+    size_t bytes = shared_pool_bytes(capacity);
+    void* mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED ||
+        mprotect((uint8_t*)mem + SHARED_POOL_HEADER_SIZE, bytes - SHARED_POOL_HEADER_SIZE, PROT_READ) != 0) {
+        printf("%s[ERROR] Cannot map shared pool %s: %s%s\n", ANSI_COLOR_RED, name, strerror(errno), ANSI_COLOR_RESET);
+        if (mem != MAP_FAILED) {
+            munmap(mem, bytes);
+        }
+        return false;
+    }
+
+    use_shared_pool(pool, fd, mem, bytes);
+    pool->attached = true;
+    printf("Attached to shared keypair pool %s (%zu keypairs, %zu generated, owner process %d)\n",
+           name, capacity, atomic_load(&pool->shared->size), (int)atomic_load(&pool->shared->owner_pid));
+    return true;
+}
+
+// The first process on the host creates the segment, every later one attaches
+// to it. The descriptor stays open: its lock is what makes a process the owner.
+static bool map_shared_pool(KeypairPool* pool, const char* name, size_t capacity) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        if (!create_shared_pool(pool, fd, name, capacity)) {
+            close(fd);
+            shm_unlink(name);
+            return false;
+        }
+        return true;
+    }
+    if (errno != EEXIST) {
+        printf("%s[ERROR] Cannot open shared pool %s: %s%s\n", ANSI_COLOR_RED, name, strerror(errno), ANSI_COLOR_RESET);
+        return false;
+    }
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        printf("%s[ERROR] Cannot open shared pool %s: %s%s\n", ANSI_COLOR_RED, name, strerror(errno), ANSI_COLOR_RESET);
+        return false;
+    }
+    if (!attach_shared_pool(pool, fd, name)) {
+        close(fd);
+        return false;
+    }
+    return true;
+}
+
+static void release_keypairs(KeypairPool* pool) {
+    if (!pool->keypairs) return;
+    if (pool->backing == POOL_BACKING_SHM) {
+        // The segment outlives this process so the pool survives restarts.
+        // Closing the descriptor drops the ownership lock.
+        munmap(pool->shared, pool->mapped_bytes);
+        close(pool->shm_fd);
+    } else if (pool->backing == POOL_BACKING_HEAP) {
+        free(pool->keypairs);
+    } else {
+        munmap(pool->keypairs, pool->mapped_bytes);
+    }
+    pool->keypairs = NULL;
+}
+
+// Create a new keypair pool with the specified capacity. A shared pool that
+// already exists keeps the capacity it was created with.
+KeypairPool* create_keypair_pool(size_t capacity, PoolBacking backing, const char* shm_name) {
+    KeypairPool* pool = (KeypairPool*)calloc(1, sizeof(KeypairPool));
     if (!pool) {
         printf("Failed to allocate memory for keypair pool\n");
         return NULL;
     }
-    
-    pool->keypairs = (Keypair*)malloc(capacity * sizeof(Keypair));
-    if (!pool->keypairs) {
+
+    pool->backing = backing;
+    if (backing == POOL_BACKING_SHM) {
+        if (!map_shared_pool(pool, shm_name, capacity)) {
+            free(pool);
+            return NULL;
+        }
+        capacity = pool->shared->capacity;
+        pool->size = &pool->shared->size;
+        pool->current_index = &pool->shared->cursor;
+        pool->refreshed_batches = &pool->shared->refreshed_batches;
+    } else {
+        pool->keypairs = allocate_keypairs(pool, capacity * sizeof(Keypair));
+        pool->size = &pool->local_size;
+        pool->current_index = &pool->local_index;
+        pool->refreshed_batches = &pool->local_refreshed;
+        pool->owner = true;
+        atomic_init(pool->size, 0);
+        atomic_init(pool->current_index, 0);
+        atomic_init(pool->refreshed_batches, 0);
+    }
+    pool->batch_count = (capacity + GEN_BATCH_SIZE - 1) / GEN_BATCH_SIZE;
+    pool->batch_done = (uint8_t*)calloc(pool->batch_count, 1);
+    if (backing != POOL_BACKING_SHM) {
+        pool->batch_generation = calloc(pool->batch_count, sizeof(*pool->batch_generation));
+    }
+    if (!pool->keypairs || !pool->batch_done || !pool->batch_generation) {
         printf("Failed to allocate memory for keypairs\n");
+        if (pool->backing != POOL_BACKING_SHM) {
+            free(pool->batch_generation);
+        }
+        release_keypairs(pool);
+        free(pool->batch_done);
         free(pool);
         return NULL;
     }
-    
-    pool->size = 0;
+
     pool->capacity = capacity;
-    pool->current_index = 0;
+    atomic_init(&pool->next_batch, 0);
+    atomic_init(&pool->epoch, 0);
+    atomic_init(&pool->claim_epoch, 0);
+    atomic_init(&pool->stop, false);
     pthread_mutex_init(&pool->mutex, NULL);
-    
+
     return pool;
 }
 
 // Free a keypair pool
 void free_keypair_pool(KeypairPool* pool) {
     if (pool) {
-        if (pool->keypairs) {
-            free(pool->keypairs);
+        stop_keypair_generation(pool);
+        if (pool->backing != POOL_BACKING_SHM) {
+            free(pool->batch_generation);
         }
+        release_keypairs(pool);
+        free(pool->batch_done);
         pthread_mutex_destroy(&pool->mutex);
         free(pool);
     }
 }
 
-// Generate a single keypair
-static void generate_keypair(Keypair* keypair) {
+static bool refill_key_stream(KeyStream* stream) {
+    static const uint8_t iv[16] = {0};  // Every key encrypts exactly one block
+    int len;
+
+    if (!stream->cipher) {
+        stream->cipher = EVP_CIPHER_CTX_new();
+        if (!stream->cipher) return false;
+        stream->refills = KEY_STREAM_RESEED;
+    }
+    if (stream->refills >= KEY_STREAM_RESEED) {
+        uint8_t seed[32];
+        if (RAND_bytes(seed, sizeof(seed)) != 1) return false;
+        for (int i = 0; i < 32; i++) {
+            stream->key[i] ^= seed[i];
+        }
+        OPENSSL_cleanse(seed, sizeof(seed));
+        stream->refills = 0;
+    }
+
+    memset(stream->block, 0, KEY_STREAM_BLOCK);
+    if (EVP_EncryptInit_ex(stream->cipher, EVP_chacha20(), NULL, stream->key, iv) != 1 ||
+        EVP_EncryptUpdate(stream->cipher, stream->block, &len, stream->block, KEY_STREAM_BLOCK) != 1) {
+        return false;
+    }
+    memcpy(stream->key, stream->block, 32);
+    OPENSSL_cleanse(stream->block, 32);
+    stream->offset = 32;
+    stream->refills++;
+    return true;
+}
+
+static bool read_key_stream(uint8_t out[32]) {
+    KeyStream* stream = &t_key_stream;
+    if ((!stream->cipher || stream->offset + 32 > KEY_STREAM_BLOCK) && !refill_key_stream(stream)) {
+        return false;
+    }
+    memcpy(out, stream->block + stream->offset, 32);
+    OPENSSL_cleanse(stream->block + stream->offset, 32);
+    stream->offset += 32;
+    return true;
+}
+
+// Wipe the calling thread's keystream before it exits
+static void free_key_stream(void) {
+    EVP_CIPHER_CTX_free(t_key_stream.cipher);
+    OPENSSL_cleanse(&t_key_stream, sizeof(t_key_stream));
+}
+
+// Generate a single keypair and its hash midstate
+bool generate_keypair(const secp256k1_context* ctx, Keypair* keypair) {
     secp256k1_pubkey pub;
-    
+
     // Generate private key
     do {
-        if (RAND_bytes(keypair->private_key, 32) != 1) {
+        if (!read_key_stream(keypair->private_key)) {
             printf("Failed to generate random bytes\n");
-            exit(1);
+            return false;
         }
     } while (!secp256k1_ec_seckey_verify(ctx, keypair->private_key));
 
     // Generate public key
     if (!secp256k1_ec_pubkey_create(ctx, &pub, keypair->private_key)) {
         printf("Failed to create public key\n");
-        exit(1);
+        return false;
     }
 
     // Serialize public key
     size_t len = 65;
     if (!secp256k1_ec_pubkey_serialize(ctx, keypair->public_key, &len, &pub, SECP256K1_EC_UNCOMPRESSED)) {
         printf("Failed to serialize public key\n");
-        exit(1);
+        return false;
+    }
+
+    // Precompute the hash state over the pubkey hex prefix
+    sha256_pubkey_midstate(keypair->midstate, keypair->public_key);
+    return true;
+}
+
+// Keypairs for the private keys base_key + first .. base_key + first + count - 1.
+// One scalar multiplication per call; every further public key is one point
+// addition of G.
+bool generate_keypair_range(const secp256k1_context* ctx, const uint8_t base_key[32], uint64_t first,
+                            Keypair* keypairs, size_t count) {
+    uint8_t key[32];
+    uint8_t tweak[32] = {0};
+    uint8_t one[32] = {0};
+    secp256k1_pubkey pub;
+    secp256k1_pubkey generator;
+
+    memcpy(key, base_key, 32);
+    for (int i = 0; i < 8; i++) {
+        tweak[31 - i] = (uint8_t)(first >> (i * 8));
+    }
+    one[31] = 1;
+    if ((first && !secp256k1_ec_seckey_tweak_add(ctx, key, tweak)) ||
+        !secp256k1_ec_pubkey_create(ctx, &pub, key) ||
+        !secp256k1_ec_pubkey_create(ctx, &generator, one)) {
+        printf("Failed to derive keypair range\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Keypair* keypair = &keypairs[i];
+        size_t len = 65;
+        memcpy(keypair->private_key, key, 32);
+        if (!secp256k1_ec_pubkey_serialize(ctx, keypair->public_key, &len, &pub, SECP256K1_EC_UNCOMPRESSED)) {
+            printf("Failed to serialize public key\n");
+            return false;
+        }
+        sha256_pubkey_midstate(keypair->midstate, keypair->public_key);
+
+        if (i + 1 < count) {
+            const secp256k1_pubkey* points[2] = {&pub, &generator};
+            secp256k1_pubkey next;
+            if (!secp256k1_ec_pubkey_combine(ctx, &next, points, 2) ||
+                !secp256k1_ec_seckey_tweak_add(ctx, key, one)) {
+                printf("Failed to step keypair range\n");
+                return false;
+            }
+            pub = next;
+        }
+    }
+    return true;
+}
+
+// Mark a batch as generated and extend the published prefix as far as possible
+static void publish_batch(KeypairPool* pool, size_t batch) {
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->batch_done[batch] = 1;
+    while (pool->batches_published < pool->batch_count && pool->batch_done[pool->batches_published]) {
+        pool->batches_published++;
+    }
+
+    size_t size = pool->batches_published * GEN_BATCH_SIZE;
+    if (size > pool->capacity) {
+        size = pool->capacity;
+    }
+    size_t previous = atomic_load(pool->size);
+    atomic_store_explicit(pool->size, size, memory_order_release);
+
+    // Print progress every 10%
+    if (size != previous &&
+        (previous == 0 || size == pool->capacity || size * 10 / pool->capacity != previous * 10 / pool->capacity)) {
+        printf("Generated %zu/%zu keypairs (%.1f%%)\n",
+               size, pool->capacity, (float)size / pool->capacity * 100);
+        fflush(stdout);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// First fill of one batch. Nobody reads these slots until it is published.
+static bool fill_batch(KeypairPool* pool, const secp256k1_context* ctx, size_t batch) {
+    size_t start = batch * GEN_BATCH_SIZE;
+    size_t end = start + GEN_BATCH_SIZE < pool->capacity ? start + GEN_BATCH_SIZE : pool->capacity;
+    if (pool->sequential) {
+        return generate_keypair_range(ctx, pool->base_key, start, &pool->keypairs[start], end - start);
+    }
+    for (size_t i = start; i < end; i++) {
+        if (!generate_keypair(ctx, &pool->keypairs[i])) {
+            return false;
+        }
     }
+    return true;
 }
 
-// Thread function for parallel keypair generation
+// Thread function for background keypair generation
 static void* generate_keypairs_thread(void* arg) {
-    ThreadGenData* data = (ThreadGenData*)arg;
-    KeypairPool* pool = data->pool;
-    size_t start_index = data->start_index;
-    size_t count = data->count;
-    
+    KeypairPool* pool = (KeypairPool*)arg;
+    bool low_priority = false;
+
     // Create thread-local secp256k1 context
     secp256k1_context* thread_ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
     if (!thread_ctx) {
         printf("Failed to create secp256k1 context for thread\n");
         return NULL;
     }
-    
-    // Generate keypairs in batches for better performance
-    const size_t batch_size = 10000;
-    size_t remaining = count;
-    size_t generated = 0;
-    
-    while (remaining > 0) {
-        size_t current_batch = (remaining < batch_size) ? remaining : batch_size;
-        
-        for (size_t i = 0; i < current_batch; i++) {
-            // Generate keypair
-            secp256k1_pubkey pub;
-            
-            // Generate private key
-            do {
-                if (RAND_bytes(pool->keypairs[start_index + generated + i].private_key, 32) != 1) {
-                    printf("Failed to generate random bytes\n");
-                    secp256k1_context_destroy(thread_ctx);
-                    return NULL;
-                }
-            } while (!secp256k1_ec_seckey_verify(thread_ctx, pool->keypairs[start_index + generated + i].private_key));
-
-            // Generate public key
-            if (!secp256k1_ec_pubkey_create(thread_ctx, &pub, pool->keypairs[start_index + generated + i].private_key)) {
-                printf("Failed to create public key\n");
-                secp256k1_context_destroy(thread_ctx);
-                return NULL;
+
+    while (!atomic_load_explicit(&pool->stop, memory_order_relaxed)) {
+        size_t batch = atomic_fetch_add(&pool->next_batch, 1);
+
+        if (batch < pool->batch_count) {
+            // Nothing after this batch can be published until it is, so a
+            // failed batch is retried rather than dropped
+            bool filled = fill_batch(pool, thread_ctx, batch);
+            while (!filled && !atomic_load_explicit(&pool->stop, memory_order_relaxed)) {
+                printf("%s[WARN] Generating keypair batch %zu failed, retrying%s\n",
+                       ANSI_COLOR_YELLOW, batch, ANSI_COLOR_RESET);
+                free_key_stream();
+                usleep(GEN_RETRY_US);
+                filled = fill_batch(pool, thread_ctx, batch);
             }
+            if (filled) {
+                publish_batch(pool, batch);
+            }
+            continue;
+        }
+
+        // A keyspace range keeps its keys for good, see start_keypair_generation
+        if (!pool->refresh || pool->sequential) {
+            break;
+        }
+
+        // Pool is full: keep replacing entries, but only with CPU time nobody else wants
+        if (!low_priority) {
+            setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+            low_priority = true;
+        }
 
-            // Serialize public key
-            size_t len = 65;
-            if (!secp256k1_ec_pubkey_serialize(thread_ctx, pool->keypairs[start_index + generated + i].public_key, &len, &pub, SECP256K1_EC_UNCOMPRESSED)) {
-                printf("Failed to serialize public key\n");
-                secp256k1_context_destroy(thread_ctx);
-                return NULL;
+        // Published slots are being hashed, so build each keypair aside and
+        // copy it in whole. mine_block re-verifies a keypair before submitting.
+        batch %= pool->batch_count;
+        size_t start = batch * GEN_BATCH_SIZE;
+        size_t end = start + GEN_BATCH_SIZE < pool->capacity ? start + GEN_BATCH_SIZE : pool->capacity;
+        bool failed = false;
+        for (size_t i = start; i < end && !atomic_load_explicit(&pool->stop, memory_order_relaxed); i++) {
+            Keypair staging;
+            if (!generate_keypair(thread_ctx, &staging)) {
+                failed = true;
+                break;
             }
+            memcpy_simd((uint8_t*)&pool->keypairs[i], (const uint8_t*)&staging, sizeof(Keypair));
         }
-        
-        generated += current_batch;
-        remaining -= current_batch;
-        
-        // Update progress
-        pthread_mutex_lock(data->progress_mutex);
-        *data->total_generated += current_batch;
-        
-        // Print progress
-        if (*data->total_generated % 10000 == 0 || *data->total_generated == data->total_to_generate) {
-            printf("Generated %zu/%zu keypairs (%.1f%%)\n", 
-                   *data->total_generated, data->total_to_generate, 
-                   (float)*data->total_generated / data->total_to_generate * 100);
-            fflush(stdout);
+
+        // Tells the device thread the batch needs uploading again
+        atomic_fetch_add_explicit(&pool->batch_generation[batch], 1, memory_order_release);
+        atomic_fetch_add_explicit(pool->refreshed_batches, 1, memory_order_release);
+        if (failed) {
+            // The old keypairs left in the batch are still valid, try again later
+            free_key_stream();
+            usleep(GEN_RETRY_US);
         }
-        pthread_mutex_unlock(data->progress_mutex);
     }
-    
+
     // Clean up thread context
+    free_key_stream();
     secp256k1_context_destroy(thread_ctx);
-    
+
     return NULL;
 }
 
-// Pre-generate keypairs and add them to the pool using multiple threads
-void pregenerate_keypairs(KeypairPool* pool, size_t count) {
-    if (!pool || !pool->keypairs) {
-        return;
+static bool start_generator_threads(KeypairPool* pool, int thread_count) {
+    pool->threads = (pthread_t*)malloc(thread_count * sizeof(pthread_t));
+    if (!pool->threads) {
+        printf("Failed to allocate memory for threads\n");
+        return false;
     }
-    
-    // Ensure we don't exceed capacity
-    if (count > pool->capacity) {
-        count = pool->capacity;
-    }
-    
-    // Create secp256k1 context if not already created
-    if (!ctx) {
-        ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
-        if (!ctx) {
-            printf("Failed to create secp256k1 context\n");
-            exit(1);
+
+    printf("Generating %zu keypairs in the background using %d threads%s\n",
+           pool->capacity, thread_count, pool->refresh ? " (refreshing once full)" : "");
+
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, generate_keypairs_thread, pool) != 0) {
+            printf("Failed to create thread %d\n", i);
+            break;
         }
+        pool->thread_count++;
     }
-    
-    printf("Pre-generating %zu keypairs using parallel threads...\n", count);
-    
-    // Determine number of threads to use
-    int num_threads = 24;
-    
-    printf("Using %d threads for keypair generation\n", num_threads);
-    
-    // Create threads
-    pthread_t* threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
-    ThreadGenData* thread_data = (ThreadGenData*)malloc(num_threads * sizeof(ThreadGenData));
-    
-    if (!threads || !thread_data) {
-        printf("Failed to allocate memory for threads\n");
-        free(threads);
-        free(thread_data);
-        return;
+
+    return pool->thread_count > 0;
+}
+
+// Become the generating process of a shared pool whose owner is gone: the
+// published prefix is kept and generation resumes after it. The caller holds
+// the segment lock.
+static bool take_over_shared_pool(KeypairPool* pool) {
+    SharedPoolHeader* header = pool->shared;
+    if (mprotect(pool->keypairs, pool->mapped_bytes - SHARED_POOL_HEADER_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        printf("%s[ERROR] Cannot take over shared pool: %s%s\n", ANSI_COLOR_RED, strerror(errno), ANSI_COLOR_RESET);
+        flock(pool->shm_fd, LOCK_UN);
+        return false;
     }
-    
-    // Initialize progress tracking
-    pthread_mutex_t progress_mutex = PTHREAD_MUTEX_INITIALIZER;
-    size_t total_generated = 0;
-    
-    // Calculate keypairs per thread
-    size_t keypairs_per_thread = count / num_threads;
-    size_t remaining_keypairs = count % num_threads;
-    
-    // Create and start threads
-    size_t start_index = 0;
-    for (int i = 0; i < num_threads; i++) {
-        thread_data[i].pool = pool;
-        thread_data[i].start_index = start_index;
-        thread_data[i].count = keypairs_per_thread + (i < remaining_keypairs ? 1 : 0);
-        thread_data[i].progress_mutex = &progress_mutex;
-        thread_data[i].total_generated = &total_generated;
-        thread_data[i].total_to_generate = count;
-        
-        if (pthread_create(&threads[i], NULL, generate_keypairs_thread, &thread_data[i]) != 0) {
-            printf("Failed to create thread %d\n", i);
-            // Clean up and exit
-            for (int j = 0; j < i; j++) {
-                pthread_join(threads[j], NULL);
+    int previous = (int)atomic_exchange(&header->owner_pid, (int32_t)getpid());
+
+    pthread_mutex_lock(&pool->mutex);
+    size_t size = atomic_load_explicit(pool->size, memory_order_acquire);
+    size_t published = size >= pool->capacity ? pool->batch_count : size / GEN_BATCH_SIZE;
+    memset(pool->batch_done, 1, published);
+    pool->batches_published = published;
+    atomic_store(&pool->next_batch, published);
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool->owner = true;
+    printf("Took over shared keypair pool from process %d at %zu/%zu keypairs\n", previous, size, pool->capacity);
+    return true;
+}
+
+// Agree with the shared segment on which keys it holds. The owner declares
+// them before publishing anything; an attacher waits for that (taking the
+// segment over if the owner dies first) and refuses a pool of other keys.
+static bool claim_shared_pool(KeypairPool* pool) {
+    SharedPoolHeader* header = pool->shared;
+    uint32_t keys;
+    bool waiting = false;
+
+    while ((keys = atomic_load_explicit(&header->keys, memory_order_acquire)) == SHARED_KEYS_PENDING && !pool->owner) {
+        if (flock(pool->shm_fd, LOCK_EX | LOCK_NB) == 0) {
+            if (!take_over_shared_pool(pool)) {
+                return false;
             }
-            pthread_mutex_destroy(&progress_mutex);
-            free(threads);
-            free(thread_data);
-            return;
+            break;
+        }
+        if (!waiting) {
+            printf("Waiting for process %d to start filling the shared pool\n", (int)atomic_load(&header->owner_pid));
+            waiting = true;
         }
-        
-        start_index += thread_data[i].count;
-    }
-    
-    // Wait for all threads to complete
-    for (int i = 0; i < num_threads; i++) {
-        pthread_join(threads[i], NULL);
-    }
-    
-    // Clean up
-    pthread_mutex_destroy(&progress_mutex);
-    free(threads);
-    free(thread_data);
-    
-    pool->size = count;
-    printf("Keypair generation complete. Pool size: %zu\n", pool->size);
+        usleep(SHARED_POOL_POLL_US);
+    }
+
+    if (keys == SHARED_KEYS_PENDING) {
+        if (pool->sequential) {
+            memcpy(header->base_key, pool->base_key, 32);
+        }
+        atomic_store_explicit(&header->keys, pool->sequential ? SHARED_KEYS_RANGE : SHARED_KEYS_RANDOM,
+                              memory_order_release);
+        return true;
+    }
+    if (keys == SHARED_KEYS_RANDOM && !pool->sequential) {
+        return true;
+    }
+    if (keys == SHARED_KEYS_RANGE && pool->sequential && memcmp(header->base_key, pool->base_key, 32) == 0) {
+        return true;
+    }
+
+    char held[65];
+    hex_encode_simd(held, header->base_key, 32);
+    held[64] = '\0';
+    printf("%s[ERROR] Shared pool holds %s%s, not the keys this process mines; use another pool_shm_name%s\n",
+           ANSI_COLOR_RED, keys == SHARED_KEYS_RANGE ? "the range from " : "random keys",
+           keys == SHARED_KEYS_RANGE ? held : "", ANSI_COLOR_RESET);
+    return false;
 }
 
-// Get the next keypair from the pool
-Keypair* get_next_keypair(KeypairPool* pool) {
-    if (!pool || !pool->keypairs || pool->size == 0) {
-        return NULL;
+// Waits for the owner of a shared pool to go away and takes the fill over
+static void* standby_thread(void* arg) {
+    KeypairPool* pool = (KeypairPool*)arg;
+
+    while (!atomic_load_explicit(&pool->stop, memory_order_relaxed)) {
+        if (flock(pool->shm_fd, LOCK_EX | LOCK_NB) == 0) {
+            if (take_over_shared_pool(pool)) {
+                start_generator_threads(pool, pool->wanted_threads);
+            }
+            break;
+        }
+        usleep(SHARED_POOL_POLL_US);
+    }
+    return NULL;
+}
+
+// Start filling the pool in the background. Returns once the threads are running.
+// With a base key the pool holds the contiguous keyspace range starting there.
+bool start_keypair_generation(KeypairPool* pool, int thread_count, bool refresh, const uint8_t* base_key) {
+    if (!pool || !pool->keypairs || thread_count <= 0) {
+        return false;
+    }
+
+    pool->sequential = base_key != NULL;
+    if (base_key) {
+        memcpy(pool->base_key, base_key, 32);
+        // Refreshing would replace the range with random keys: coordinator
+        // ranges would overlap, replays and checkpoints would see other keys
+        if (refresh) {
+            printf("%s[WARN] pool_refresh is turned off for a keyspace range (pool_seed or coordinator)%s\n",
+                   ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+            refresh = false;
+        }
+    }
+    pool->refresh = refresh;
+
+    if (pool->backing == POOL_BACKING_SHM && !claim_shared_pool(pool)) {
+        return false;
+    }
+    if (!pool->owner) {
+        // Another process generates into the shared segment
+        pool->wanted_threads = thread_count;
+        if (pthread_create(&pool->standby, NULL, standby_thread, pool) != 0) {
+            printf("Failed to create standby thread\n");
+            return false;
+        }
+        pool->standby_running = true;
+        return true;
+    }
+
+    return start_generator_threads(pool, thread_count);
+}
+
+// Stop and join the generator threads
+void stop_keypair_generation(KeypairPool* pool) {
+    if (!pool) {
+        return;
+    }
+
+    atomic_store(&pool->stop, true);
+    // The standby thread may start generators on its way out
+    if (pool->standby_running) {
+        pthread_join(pool->standby, NULL);
+        pool->standby_running = false;
+    }
+    if (!pool->threads) {
+        return;
+    }
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
     }
-    
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->thread_count = 0;
+}
+
+// Throw the pool away and fill it again from base_key. Mining stops until
+// the first batch of the new range is published.
+bool restart_keypair_generation(KeypairPool* pool, int thread_count, bool refresh, const uint8_t* base_key) {
+    if (!pool) {
+        return false;
+    }
+    if (pool->backing == POOL_BACKING_SHM) {
+        // Other processes mine the segment, it keeps the keys it was declared
+        // with. main() doesn't let a coordinator hand ranges to a shared pool.
+        if (base_key && pool->sequential && memcmp(base_key, pool->base_key, 32) == 0) {
+            return true;
+        }
+        printf("%s[ERROR] A shared pool cannot be refilled with another keyspace range%s\n",
+               ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    stop_keypair_generation(pool);
     pthread_mutex_lock(&pool->mutex);
-    
-    // Get the current keypair
-    Keypair* keypair = &pool->keypairs[pool->current_index];
-    
-    // Update the index for the next call
-    pool->current_index = (pool->current_index + 1) % pool->size;
-    
+    atomic_store_explicit(pool->size, 0, memory_order_release);
+    atomic_store(pool->current_index, 0);
+    memset(pool->batch_done, 0, pool->batch_count);
+    pool->batches_published = 0;
+    atomic_store(&pool->next_batch, 0);
+    atomic_store(&pool->stop, false);
+    atomic_fetch_add(&pool->epoch, 1);
+    atomic_fetch_add_explicit(&pool->claim_epoch, 1, memory_order_release);
     pthread_mutex_unlock(&pool->mutex);
-    
-    return keypair;
-} 
\ No newline at end of file
+
+    return start_keypair_generation(pool, thread_count, refresh, base_key);
+}
+
+// Get the next keypair from the pool, NULL while every published keypair is
+// claimed and the pool is still filling
+Keypair* get_next_keypair(KeypairPool* pool) {
+    // Each thread claims a range of indices so the shared cursor is touched
+    // once per KEYPAIR_CLAIM_SIZE hashes instead of on every hash
+    static __thread size_t next = 0;
+    static __thread size_t end = 0;
+    static __thread uint32_t claimed_epoch = 0;
+
+    if (!pool || !pool->keypairs) {
+        return NULL;
+    }
+    size_t size = atomic_load_explicit(pool->size, memory_order_acquire);
+    if (size == 0) {
+        return NULL;
+    }
+
+    // A claim made before the cursor was moved belongs to the old position
+    uint32_t epoch = atomic_load_explicit(&pool->claim_epoch, memory_order_acquire);
+    if (next == end || claimed_epoch != epoch) {
+        next = atomic_fetch_add_explicit(pool->current_index, KEYPAIR_CLAIM_SIZE, memory_order_relaxed);
+        end = next + KEYPAIR_CLAIM_SIZE;
+        claimed_epoch = epoch;
+    }
+
+    // Wrap only over a full pool. During the fill a claim past the published
+    // prefix is kept until its batch is published.
+    size_t index = next % pool->capacity;
+    if (index >= size) {
+        return NULL;
+    }
+    next++;
+    return &pool->keypairs[index];
+}
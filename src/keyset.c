@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/keyset.h"
+
+#define KEYSET_MIN_CAPACITY 64
+
+// Hashes that meet a difficulty start with zero bytes, so index by the last
+// bytes, mixed in case those are not uniform either
+static size_t slot_of(const KeySet* set, const uint8_t key[32]) {
+    uint64_t h;
+    memcpy(&h, key + 24, sizeof(h));
+    h = (h ^ (h >> 29)) * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 32;
+    return (size_t)h & (set->capacity - 1);
+}
+
+static bool lookup(const KeySet* set, const uint8_t key[32], size_t* slot) {
+    size_t i = slot_of(set, key);
+    while (set->used[i]) {
+        if (memcmp(set->keys[i], key, 32) == 0) {
+            *slot = i;
+            return true;
+        }
+        i = (i + 1) & (set->capacity - 1);
+    }
+    *slot = i;
+    return false;
+}
+
+static bool grow(KeySet* set) {
+    size_t capacity = set->capacity ? set->capacity * 2 : KEYSET_MIN_CAPACITY;
+    KeySet bigger = {
+        .keys = malloc(capacity * 32),
+        .used = calloc(capacity, sizeof(bool)),
+        .count = set->count,
+        .capacity = capacity,
+    };
+    if (!bigger.keys || !bigger.used) {
+        free(bigger.keys);
+        free(bigger.used);
+        return false;
+    }
+
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->used[i]) {
+            size_t slot;
+            lookup(&bigger, set->keys[i], &slot);
+            memcpy(bigger.keys[slot], set->keys[i], 32);
+            bigger.used[slot] = true;
+        }
+    }
+    keyset_free(set);
+    *set = bigger;
+    return true;
+}
+
+bool keyset_insert(KeySet* set, const uint8_t key[32]) {
+    // Keep the table at most half full, but never let it fill up
+    if ((set->count + 1) * 2 > set->capacity && !grow(set) && set->count + 1 >= set->capacity) {
+        return true;
+    }
+
+    size_t slot;
+    if (lookup(set, key, &slot)) {
+        return false;
+    }
+    memcpy(set->keys[slot], key, 32);
+    set->used[slot] = true;
+    set->count++;
+    return true;
+}
+
+void keyset_clear(KeySet* set) {
+    if (set->used) {
+        memset(set->used, 0, set->capacity * sizeof(bool));
+    }
+    set->count = 0;
+}
+
+void keyset_free(KeySet* set) {
+    free(set->keys);
+    free(set->used);
+    memset(set, 0, sizeof(*set));
+}
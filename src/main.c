@@ -4,8 +4,19 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <time.h>
+#include <signal.h>
 #include <curl/curl.h>
 #include "../include/miner.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+#include "../include/simd.h"
+#include "../include/coordinator.h"
+#include "../include/replay.h"
+#include "../include/control.h"
+#include "../include/autotune.h"
+#include "../include/servers.h"
+#include "../include/checkpoint.h"
+#include "../include/joblog.h"
 
 // Global variables
 uint8_t* g_best_hash = NULL;
@@ -20,108 +31,275 @@ pthread_mutex_t g_hash_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define ANSI_COLOR_CYAN    "\x1b[36m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
-#define MAX_THREADS 384
-
 typedef struct {
-    const MinerConfig* config;
     Job* job;
     uint64_t* hash_count;
     double* total_mined;
     pthread_mutex_t* job_mutex;
+    int thread_id;
+    _Atomic bool* stop;  // Mining threads exit once this is set
 } ThreadData;
 
+// Hashes per mining thread between job checks, unless tuned
+#define JOB_CHECK_INTERVAL 100
+
+#define CONFIG_FILE "cminer.conf"
+
+// Current configuration. A reload swaps in a freshly loaded one; the old one is
+// retired and freed once no thread can still be reading it.
+static _Atomic(MinerConfig*) g_config;
+
+static const MinerConfig* live_config(void) {
+    return atomic_load(&g_config);
+}
+
+// Threads hold a config for at most one submission with its retry (twice the
+// 30 second timeout), so a retired config is freed two minutes later. The
+// startup config is never retired: the coordinator and replay keep it.
+#define CONFIG_GRACE_SECONDS 120
+#define MAX_RETIRED_CONFIGS 16
+
+typedef struct {
+    MinerConfig* config;
+    time_t retired;
+} RetiredConfig;
+
+static RetiredConfig g_retired[MAX_RETIRED_CONFIGS];
+static int g_retired_count = 0;
+static MinerConfig* g_startup_config = NULL;
+
+// Free retired configs past their grace period, with g_reload_mutex held.
+// Returns false when every slot is still in use.
+static bool free_retired_configs(time_t now) {
+    int kept = 0;
+    for (int i = 0; i < g_retired_count; i++) {
+        if (now - g_retired[i].retired >= CONFIG_GRACE_SECONDS) {
+            free_config(g_retired[i].config);
+        } else {
+            g_retired[kept++] = g_retired[i];
+        }
+    }
+    g_retired_count = kept;
+    return g_retired_count < MAX_RETIRED_CONFIGS;
+}
+
+// Mining threads, resized by reloads and the control socket
+static pthread_t g_mining_threads[MAX_THREADS];
+static ThreadData g_mining_data[MAX_THREADS];
+static _Atomic bool g_mining_stop[MAX_THREADS];
+static int g_mining_count = 0;
+static int g_device_slot = -1;  // Metrics slot of the device thread, -1 without one
+static pthread_mutex_t g_reload_mutex = PTHREAD_MUTEX_INITIALIZER;  // Guards reloads and resizing
+
+// Measured settings when autotune is on
+static TuneProfile g_profile;
+static bool g_tuned = false;
+static int g_job_check_interval = JOB_CHECK_INTERVAL;
+
+// Report, submit and save a found solution, then clear it
+static bool handle_solution(ThreadData* data, Solution* solution) {
+    const MinerConfig* config = live_config();
+    
+    printf("\n\n%s[INFO] Found %.2f CLCs!%s\n", ANSI_COLOR_GREEN, solution->reward, ANSI_COLOR_RESET);
+    printf("%s[INFO] Hash: %s%s\n", ANSI_COLOR_CYAN, solution->hash, ANSI_COLOR_RESET);
+    
+    // Replayed jobs are stale, only count what would have been submitted
+    if (strlen(config->job_replay) > 0) {
+        printf("%s[INFO] Replay mode, not submitting.%s\n\n", ANSI_COLOR_BLUE, ANSI_COLOR_RESET);
+        free(solution->hash);
+        memset(solution, 0, sizeof(Solution));
+        return false;
+    }
+    
+    // Workers hand solutions to the coordinator, which submits and saves them
+    if (strlen(config->coordinator) > 0) {
+        if (coordinator_relay_solution(solution)) {
+            printf("%s[INFO] Relayed to coordinator.%s\n\n", ANSI_COLOR_GREEN, ANSI_COLOR_RESET);
+        } else {
+            printf("%s[ERROR] Not connected to coordinator, solution lost%s\n\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        }
+        free(solution->hash);
+        memset(solution, 0, sizeof(Solution));
+        return false;
+    }
+    
+    TRACE_BEGIN(submit);
+    bool submitted = submit_solution(config, solution);
+    TRACE_END(submit, TRACE_SUBMIT);
+    if (submitted) {
+        printf("%s[INFO] Successfully submitted.%s\n\n", ANSI_COLOR_GREEN, ANSI_COLOR_RESET);
+        *data->total_mined += solution->reward;
+        
+        // Save reward
+        save_reward(config, solution, time(NULL));
+    }
+    
+    free(solution->hash);
+    memset(solution, 0, sizeof(Solution));
+    return submitted;
+}
+
 static void* mining_thread(void* arg) {
     ThreadData* data = (ThreadData*)arg;
     Solution solution = {0};
-    uint64_t local_hash_count = 0;
+    Job current_job = {0};  // Private copy, refreshed only when the job id changes
     
-    while (1) {
+    while (!atomic_load_explicit(data->stop, memory_order_relaxed)) {
+        TRACE_BEGIN(job);
         pthread_mutex_lock(data->job_mutex);
-        if (!data->job->seed || strcmp(data->job->seed, "wait") == 0) {
+        if (data->job->id == 0 || !mining_ready()) {
             pthread_mutex_unlock(data->job_mutex);
             usleep(100000);  // Sleep 100ms
             continue;
         }
-        Job current_job = *data->job;
+        bool job_changed = data->job->id != current_job.id;
+        if (job_changed) {
+            current_job = *data->job;
+        }
         pthread_mutex_unlock(data->job_mutex);
+        TRACE_END(job, TRACE_JOB_CHECK);
+        
+        if (job_changed) {
+            metrics_observe_job_switch(metrics_now_ns() - atomic_load(&g_metrics.job_published_ns));
+        }
         
-        if (mine_block(data->config, &current_job, &solution)) {
-            printf("\n\n%s[INFO] Found %.2f CLCs!%s\n", ANSI_COLOR_GREEN, solution.reward, ANSI_COLOR_RESET);
-            printf("%s[INFO] Hash: %s%s\n", ANSI_COLOR_CYAN, solution.hash, ANSI_COLOR_RESET);
-            
-            if (submit_solution(data->config, &solution)) {
-                printf("%s[INFO] Successfully submitted.%s\n\n", ANSI_COLOR_GREEN, ANSI_COLOR_RESET);
-                *data->total_mined += solution.reward;
-                
-                // Save reward
-                save_reward(data->config, &solution, time(NULL));
+        const MinerConfig* config = live_config();
+        int batch = g_job_check_interval;
+        int hashed = 0;
+        for (; hashed < batch; hashed++) {
+            MineResult result = mine_block(config, &current_job, &solution);
+            if (result == MINE_STARVED) {
+                break;
             }
-            
-            free(solution.hash);
-            memset(&solution, 0, sizeof(Solution));
+            if (result == MINE_SOLVED) {
+                job_log_solution(&solution);
+                handle_solution(data, &solution);
+            }
+        }
+        if (hashed < batch) {
+            usleep(1000);  // Caught up with the generators, wait for the next batch
+        }
+        batch = hashed;
+        
+        pthread_mutex_lock(&g_hash_mutex);
+        *data->hash_count += batch;
+        pthread_mutex_unlock(&g_hash_mutex);
+        metrics_add_hashes(data->thread_id, batch);
+    }
+    
+    return NULL;
+}
+
+// Solutions taken from one backend dispatch
+#define DEVICE_MAX_SOLUTIONS 16
+
+// Feeds the compute backend one dispatch at a time
+static void* device_thread(void* arg) {
+    ThreadData* data = (ThreadData*)arg;
+    Solution solutions[DEVICE_MAX_SOLUTIONS] = {0};
+    Job current_job = {0};
+    
+    while (1) {
+        pthread_mutex_lock(data->job_mutex);
+        if (data->job->id == 0 || !mining_ready()) {
+            pthread_mutex_unlock(data->job_mutex);
+            usleep(100000);  // Sleep 100ms
+            continue;
+        }
+        bool job_changed = data->job->id != current_job.id;
+        if (job_changed) {
+            current_job = *data->job;
         }
+        pthread_mutex_unlock(data->job_mutex);
         
-        local_hash_count++;
-        if (local_hash_count % 100 == 0) {
-            pthread_mutex_lock(&g_hash_mutex);
-            *data->hash_count += 100;
-            pthread_mutex_unlock(&g_hash_mutex);
-            local_hash_count = 0;
+        if (job_changed) {
+            metrics_observe_job_switch(metrics_now_ns() - atomic_load(&g_metrics.job_published_ns));
+        }
+        
+        uint64_t hashed = 0;
+        size_t found = mine_backend_batch(&current_job, solutions, DEVICE_MAX_SOLUTIONS, &hashed);
+        for (size_t i = 0; i < found; i++) {
+            job_log_solution(&solutions[i]);
+            handle_solution(data, &solutions[i]);
+        }
+        if (hashed == 0) {
+            usleep(100000);  // Backend error, don't spin
+            continue;
         }
+        
+        pthread_mutex_lock(&g_hash_mutex);
+        *data->hash_count += hashed;
+        pthread_mutex_unlock(&g_hash_mutex);
+        metrics_add_hashes(data->thread_id, hashed);
     }
     
     return NULL;
 }
 
+// Make new_job the current job if its seed changed. new_job is the caller's
+// slot, filled in by the job source; only its tail and id are set here.
+static void publish_job(ThreadData* data, Job* new_job) {
+    bool changed = false;
+    uint8_t previous_best[32];
+    
+    pthread_mutex_lock(data->job_mutex);
+    
+    // 检查job是否变化
+    if (data->job->id == 0 || data->job->seed_len != new_job->seed_len ||
+        memcmp(data->job->seed, new_job->seed, new_job->seed_len) != 0) {
+        
+        // Compile the hash tail once so the mining threads only run the final
+        // compressions. The seed length was checked on ingest.
+        sha256_build_tail(&new_job->tail, new_job->seed, new_job->seed_len);
+        new_job->id = data->job->id + 1;
+
+        printf("\n\n%s[INFO] New job%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+        printf("%s[INFO] seed: %s%s\n", ANSI_COLOR_CYAN, new_job->seed, ANSI_COLOR_RESET);
+        char diff_hex[65];
+        hex_encode_simd(diff_hex, new_job->diff, 32);
+        diff_hex[64] = '\0';
+        printf("%s[INFO] diff: %s%s\n", ANSI_COLOR_CYAN, diff_hex, ANSI_COLOR_RESET);
+        printf("%s[INFO] reward: %.2f%s\n", ANSI_COLOR_GREEN, new_job->reward, ANSI_COLOR_RESET);
+        
+        time_t now = time(NULL);
+        time_t last_found = new_job->last_found / 1000;
+        printf("%s[INFO] Last mined %lds ago%s\n\n", ANSI_COLOR_BLUE, now - last_found, ANSI_COLOR_RESET);
+        
+        // Copy new job
+        *data->job = *new_job;
+        
+        metrics_job_published();
+        
+        // 重置最佳哈希为全F
+        pthread_mutex_lock(&g_hash_mutex);
+        memcpy(previous_best, g_best_hash, 32);
+        pthread_mutex_unlock(&g_hash_mutex);
+        reset_best_hash();
+        checkpoint_job_started(new_job->seed);
+        changed = true;
+    }
+    
+    pthread_mutex_unlock(data->job_mutex);
+    
+    // Send to workers and the record file without holding up the mining
+    // threads. new_job still matches the published job.
+    if (changed) {
+        if (strlen(live_config()->coordinator_listen) > 0) {
+            coordinator_publish_job(new_job);
+        }
+        job_record_append(new_job);
+        job_log_switch(new_job, previous_best);
+    }
+}
+
 static void* job_update_thread(void* arg) {
     ThreadData* data = (ThreadData*)arg;
+    static Job new_job;  // Fetched into in place, every poll
     
     while (1) {
-        Job* new_job = get_job(data->config->server);
-        if (new_job) {
-            pthread_mutex_lock(data->job_mutex);
-            
-            
-            // 检查job是否变化
-            if (!data->job->seed || !new_job->seed || strcmp(data->job->seed, new_job->seed) != 0) {
-                
-                printf("\n\n%s[INFO] New job%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
-                printf("%s[INFO] seed: %s%s\n", ANSI_COLOR_CYAN, new_job->seed, ANSI_COLOR_RESET);
-                printf("%s[INFO] diff: ", ANSI_COLOR_CYAN);
-                for(int i = 0; i < 32; i++) {
-                    printf("%02x", new_job->diff[i]);
-                }
-                printf("%s\n", ANSI_COLOR_RESET);
-                printf("%s[INFO] reward: %.2f%s\n", ANSI_COLOR_GREEN, new_job->reward, ANSI_COLOR_RESET);
-                
-                time_t now = time(NULL);
-                time_t last_found = new_job->last_found / 1000;
-                printf("%s[INFO] Last mined %lds ago%s\n\n", ANSI_COLOR_BLUE, now - last_found, ANSI_COLOR_RESET);
-                
-                // Free old job seed
-                if (data->job->seed) {
-                    free(data->job->seed);
-                }
-                
-                // Copy new job
-                *data->job = *new_job;
-                
-                // Prevent double free
-                new_job->seed = NULL;
-                
-                // 重置最佳哈希为全F
-                pthread_mutex_lock(&g_hash_mutex);
-                memset(g_best_hash, 0xFF, 32);
-                pthread_mutex_unlock(&g_hash_mutex);
-            }
-            
-            pthread_mutex_unlock(data->job_mutex);
-            
-            // Clean up new job
-            if (new_job->seed) {
-                free(new_job->seed);
-            }
-            free(new_job);
+        const MinerConfig* config = live_config();
+        if (fetch_job(&new_job)) {
+            publish_job(data, &new_job);
         }
         
         // 打印当前时间和等待间隔
@@ -132,14 +310,23 @@ static void* job_update_thread(void* arg) {
             timeinfo->tm_hour,
             timeinfo->tm_min, 
             timeinfo->tm_sec,
-            data->config->job_interval,
+            config->job_interval,
             ANSI_COLOR_RESET);
-        sleep(data->config->job_interval);
+        sleep(config->job_interval);
     }
     
     return NULL;
 }
 
+// Jobs from the coordinator or a replayed stream
+static void on_external_job(void* ctx, Job* job) {
+    publish_job((ThreadData*)ctx, job);
+}
+
+static bool on_relayed_solution(void* ctx, Solution* solution) {
+    return handle_solution((ThreadData*)ctx, solution);
+}
+
 static void* hash_rate_thread(void* arg) {
     ThreadData* data = (ThreadData*)arg;
     
@@ -182,7 +369,8 @@ static void* report_thread(void* arg) {
     ThreadData* data = (ThreadData*)arg;
     
     while (1) {
-        sleep(data->config->report_interval);
+        sleep(live_config()->report_interval);
+        const MinerConfig* config = live_config();
         
         pthread_mutex_lock(&g_hash_mutex);
         uint64_t hash_count = *data->hash_count;
@@ -194,8 +382,8 @@ static void* report_thread(void* arg) {
         pthread_mutex_unlock(data->job_mutex);
         
         // 报告状态
-        if (strlen(data->config->reporting.report_server) > 0) {
-            if (!report_status(data->config, hash_count, total_mined, g_best_hash)) {
+        if (strlen(config->reporting.report_server) > 0) {
+            if (!report_status(config, hash_count, total_mined, g_best_hash)) {
                 printf("%s[ERROR] Failed to report status%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
             } else {
                 printf("%s[INFO] Status reported successfully%s\n", ANSI_COLOR_GREEN, ANSI_COLOR_RESET);
@@ -206,29 +394,308 @@ static void* report_thread(void* arg) {
     return NULL;
 }
 
+// Number of mining threads for a thread setting. -1 means the tuned count,
+// or one per usable CPU without a tuned profile.
+static int resolve_thread_count(int configured) {
+    int count = configured;
+    if (count < 0) {
+        count = g_tuned ? g_profile.threads : get_available_cpus();
+    }
+    // The device thread takes a metrics slot of its own
+    int limit = mining_backend_enabled() ? MAX_THREADS - 1 : MAX_THREADS;
+    return count > limit ? limit : count;
+}
+
+// Metrics slot of mining thread index, skipping the device thread's slot
+static int mining_slot(int index) {
+    return (g_device_slot >= 0 && index >= g_device_slot) ? index + 1 : index;
+}
+
+// Grow or shrink the mining thread set to count threads, with g_reload_mutex
+// held. Returns the number of threads running afterwards.
+static int resize_mining_threads(const ThreadData* base, int count) {
+    // Surplus threads exit after their current block of hashes
+    for (int i = count; i < g_mining_count; i++) {
+        atomic_store(&g_mining_stop[i], true);
+    }
+    for (int i = count; i < g_mining_count; i++) {
+        pthread_join(g_mining_threads[i], NULL);
+    }
+    
+    for (int i = g_mining_count; i < count; i++) {
+        g_mining_data[i] = *base;
+        g_mining_data[i].thread_id = mining_slot(i);
+        g_mining_data[i].stop = &g_mining_stop[i];
+        atomic_store(&g_mining_stop[i], false);
+        if (pthread_create(&g_mining_threads[i], NULL, mining_thread, &g_mining_data[i]) != 0) {
+            printf("Failed to create mining thread %d\n", i);
+            count = i;
+            break;
+        }
+        if (g_tuned) {
+            pin_mining_thread(g_mining_threads[i], g_profile.affinity, i);
+        }
+    }
+    g_mining_count = count;
+    
+    // Slots are never handed back so the per-thread hash counters stay monotonic
+    int slots = count > 0 ? mining_slot(count - 1) + 1 : 0;
+    if (g_device_slot >= slots) {
+        slots = g_device_slot + 1;
+    }
+    if (slots > atomic_load(&g_metrics.thread_count)) {
+        atomic_store(&g_metrics.thread_count, slots);
+    }
+    atomic_store(&g_metrics.active_threads, count + (g_device_slot >= 0 ? 1 : 0));
+    return count;
+}
+
+static void create_rewards_dir(const char* path) {
+    if (access(path, F_OK) != 0) {
+        #ifdef _WIN32
+        mkdir(path);
+        #else
+        mkdir(path, 0755);
+        #endif
+    }
+}
+
+// Keys read only at startup keep their running value
+static void keep_string(const char* key, char** fresh, const char* running) {
+    if (strcmp(*fresh, running) == 0) {
+        return;
+    }
+    printf("%s[WARN] Changing %s needs a restart, keeping \"%s\"%s\n",
+        ANSI_COLOR_YELLOW, key, running, ANSI_COLOR_RESET);
+    free(*fresh);
+    *fresh = strdup(running);
+}
+
+// Re-read the config file and apply what can change while running: threads,
+// server, intervals and the submit and report settings. The keypair pool and
+// everything else set up at startup stay as they are. Call with
+// g_reload_mutex held.
+static void reload_config(const ThreadData* data, char* reply, size_t reply_size) {
+    if (access(CONFIG_FILE, R_OK) != 0) {
+        printf("%s[ERROR] Cannot read %s, keeping the current config%s\n", ANSI_COLOR_RED, CONFIG_FILE, ANSI_COLOR_RESET);
+        snprintf(reply, reply_size, "ERROR cannot read %s", CONFIG_FILE);
+        return;
+    }
+    time_t now = time(NULL);
+    if (!free_retired_configs(now)) {
+        printf("%s[ERROR] Too many reloads in the last %d seconds, keeping the current config%s\n",
+            ANSI_COLOR_RED, CONFIG_GRACE_SECONDS, ANSI_COLOR_RESET);
+        snprintf(reply, reply_size, "ERROR too many reloads, try again later");
+        return;
+    }
+    MinerConfig* fresh = load_config(CONFIG_FILE);
+    if (!fresh) {
+        snprintf(reply, reply_size, "ERROR cannot load %s", CONFIG_FILE);
+        return;
+    }
+    
+    MinerConfig* old = atomic_load(&g_config);
+    keep_string("metrics_listen", &fresh->metrics_listen, old->metrics_listen);
+    keep_string("pool_shm_name", &fresh->pool_shm_name, old->pool_shm_name);
+    keep_string("compute_backend", &fresh->compute_backend, old->compute_backend);
+    keep_string("opencl_device", &fresh->opencl_device, old->opencl_device);
+    keep_string("coordinator_listen", &fresh->coordinator_listen, old->coordinator_listen);
+    keep_string("coordinator", &fresh->coordinator, old->coordinator);
+    keep_string("worker_name", &fresh->worker_name, old->worker_name);
+    keep_string("job_record", &fresh->job_record, old->job_record);
+    keep_string("job_replay", &fresh->job_replay, old->job_replay);
+    keep_string("pool_seed", &fresh->pool_seed, old->pool_seed);
+    keep_string("control_listen", &fresh->control_listen, old->control_listen);
+    keep_string("autotune_cache", &fresh->autotune_cache, old->autotune_cache);
+    keep_string("checkpoint_file", &fresh->checkpoint_file, old->checkpoint_file);
+    keep_string("job_log", &fresh->job_log, old->job_log);
+    fresh->autotune = old->autotune;
+    if (fresh->pool_memory != old->pool_memory || fresh->pool_backing != old->pool_backing ||
+        fresh->generator_threads != old->generator_threads || fresh->pool_refresh != old->pool_refresh ||
+        fresh->opencl_batch != old->opencl_batch) {
+        printf("%s[WARN] Keypair pool and backend settings need a restart, keeping the current pool%s\n",
+            ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+    }
+    fresh->pool_memory = old->pool_memory;
+    fresh->pool_backing = old->pool_backing;
+    fresh->generator_threads = old->generator_threads;
+    fresh->pool_refresh = old->pool_refresh;
+    fresh->opencl_batch = old->opencl_batch;
+    fresh->replay_speed = old->replay_speed;
+    fresh->server_check_interval = old->server_check_interval;
+    fresh->checkpoint_interval = old->checkpoint_interval;
+    if (fresh->thread_count == 0 && !mining_backend_enabled()) {
+        printf("%s[WARN] thread = 0 without a device would stop mining, keeping %d%s\n",
+            ANSI_COLOR_YELLOW, old->thread_count, ANSI_COLOR_RESET);
+        fresh->thread_count = old->thread_count;
+    }
+    
+    create_rewards_dir(fresh->rewards_dir);
+    if (set_job_servers(fresh->server) == 0) {
+        set_job_servers(old->server);
+        keep_string("server", &fresh->server, old->server);
+    }
+    atomic_store(&g_config, fresh);
+    if (old != g_startup_config) {
+        g_retired[g_retired_count++] = (RetiredConfig){ old, now };
+    }
+    int threads = resize_mining_threads(data, resolve_thread_count(fresh->thread_count));
+    
+    printf("%s[INFO] Config reloaded: %d threads, server %s, job interval %ds%s\n",
+        ANSI_COLOR_GREEN, threads, fresh->server, fresh->job_interval, ANSI_COLOR_RESET);
+    snprintf(reply, reply_size, "OK threads=%d server=%s job_interval=%d report_interval=%d",
+        threads, fresh->server, fresh->job_interval, fresh->report_interval);
+}
+
+static void on_control_command(void* ctx, const char* command, char* reply, size_t reply_size) {
+    const ThreadData* data = (const ThreadData*)ctx;
+    
+    pthread_mutex_lock(&g_reload_mutex);
+    if (strcmp(command, "reload") == 0) {
+        reload_config(data, reply, reply_size);
+    } else if (strncmp(command, "threads ", 8) == 0) {
+        char* end;
+        long requested = strtol(command + 8, &end, 10);
+        if (end == command + 8 || *end != '\0' || requested > MAX_THREADS || requested < -1 ||
+            (requested == 0 && !mining_backend_enabled())) {
+            snprintf(reply, reply_size, "ERROR usage: threads <n> with n >= 1 (0 for the device only), -1 for one per CPU");
+        } else {
+            int threads = resize_mining_threads(data, resolve_thread_count((int)requested));
+            printf("%s[INFO] Now mining on %d threads%s\n", ANSI_COLOR_GREEN, threads, ANSI_COLOR_RESET);
+            snprintf(reply, reply_size, "OK threads=%d", threads);
+        }
+    } else if (strcmp(command, "status") == 0) {
+        const MinerConfig* config = live_config();
+        size_t size, capacity, cursor;
+        get_keypair_pool_stats(&size, &capacity, &cursor);
+        snprintf(reply, reply_size, "OK threads=%d server=%s job_interval=%d report_interval=%d pool=%zu/%zu",
+            g_mining_count, config->server, config->job_interval, config->report_interval, size, capacity);
+    } else {
+        snprintf(reply, reply_size, "ERROR unknown command, expected reload, threads <n> or status");
+    }
+    pthread_mutex_unlock(&g_reload_mutex);
+}
+
+static sigset_t g_signals;
+
+static void* signal_thread(void* arg) {
+    const ThreadData* data = (const ThreadData*)arg;
+    int dump_count = 0;
+    
+    while (1) {
+        int sig;
+        if (sigwait(&g_signals, &sig) != 0) {
+            continue;
+        }
+        
+        if (sig == SIGHUP) {
+            char reply[256];
+            printf("\n%s[INFO] SIGHUP, reloading %s%s\n", ANSI_COLOR_BLUE, CONFIG_FILE, ANSI_COLOR_RESET);
+            pthread_mutex_lock(&g_reload_mutex);
+            reload_config(data, reply, sizeof(reply));
+            pthread_mutex_unlock(&g_reload_mutex);
+        } else if (sig == SIGINT || sig == SIGTERM) {
+            // Only handled when checkpointing or logging jobs, so a restart
+            // loses no progress and the current job is still accounted for
+            save_checkpoint();
+            job_log_close();
+            printf("\n%s[INFO] Exiting%s\n", ANSI_COLOR_BLUE, ANSI_COLOR_RESET);
+            // Skip the atexit cleanup, OpenSSL would be torn down under the
+            // generator threads
+            fflush(stdout);
+            _exit(0);
+        } else if (sig == SIGUSR2) {
+            char path[256];
+            snprintf(path, sizeof(path), "cminer-trace-%d-%d.json", (int)getpid(), dump_count++);
+            trace_dump(path);
+        }
+    }
+    
+    return NULL;
+}
+
 int main() {
+    // Handle signals on a dedicated thread; every thread created below inherits this mask
+    sigemptyset(&g_signals);
+    sigaddset(&g_signals, SIGUSR2);
+    sigaddset(&g_signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &g_signals, NULL);
+    
     // Initialize CURL
     curl_global_init(CURL_GLOBAL_ALL);
+    trace_init();
     
-    // Initialize mining context
-    init_mining();
+    // Make sure job responses split across curl chunks parse the same
+    if (!job_parser_self_test()) {
+        return 1;
+    }
     
     // Load configuration
-    MinerConfig* config = load_config("cminer.conf");
+    MinerConfig* config = load_config(CONFIG_FILE);
     if (!config) {
         printf("Failed to load configuration\n");
         return 1;
     }
+    atomic_store(&g_config, config);
+    g_startup_config = config;
     
-    // Create rewards directory if it doesn't exist
-    if (access(config->rewards_dir, F_OK) != 0) {
-        #ifdef _WIN32
-        mkdir(config->rewards_dir);
-        #else
-        mkdir(config->rewards_dir, 0755);
-        #endif
+    // A shared segment holds one set of keys for every process on the host,
+    // while a coordinator gives each process its own range and reassigns
+    // ranges when it restarts
+    if (config->pool_backing == POOL_BACKING_SHM &&
+        (strlen(config->coordinator) > 0 || strlen(config->coordinator_listen) > 0)) {
+        printf("%s[ERROR] pool_backing = \"shm\" cannot be combined with coordinator or coordinator_listen, "
+               "every process needs a pool of its own range%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        return 1;
+    }
+    
+    // A replay is only reproducible against a pool that holds the same keys on
+    // every run and that no other process takes candidates from
+    if (strlen(config->job_replay) > 0 &&
+        (strlen(config->pool_seed) == 0 || config->pool_refresh || config->pool_backing == POOL_BACKING_SHM ||
+         strlen(config->coordinator) > 0 || strlen(config->coordinator_listen) > 0)) {
+        printf("%s[ERROR] job_replay needs pool_seed, pool_refresh = false and a private pool "
+               "(no shm backing, no coordinator)%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        return 1;
+    }
+    
+    // Progress is only worth keeping for a pool that holds the same keys after
+    // a restart. A replay has to start from scratch to be reproducible.
+    bool checkpointing = strlen(config->checkpoint_file) > 0 && strlen(config->job_replay) == 0 &&
+        (strlen(config->pool_seed) > 0 || strlen(config->coordinator) > 0 ||
+         strlen(config->coordinator_listen) > 0);
+    // A shared cursor is moved by every attached process, and a resume in one
+    // would leave the others hashing from their old claims
+    if (checkpointing && config->pool_backing == POOL_BACKING_SHM) {
+        printf("%s[WARN] checkpoint_file is ignored with pool_backing = \"shm\"%s\n",
+            ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+        checkpointing = false;
+    }
+    if (checkpointing || strlen(config->job_log) > 0) {
+        sigaddset(&g_signals, SIGINT);
+        sigaddset(&g_signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &g_signals, NULL);
     }
     
+    // Initialize mining context, the keypair pool fills in the background
+    init_mining(config);
+    
+    // Benchmark before the keypair generators compete for the CPUs
+    if (config->autotune) {
+        g_tuned = autotune(config->autotune_cache, mining_backend_enabled(), &g_profile);
+        if (g_tuned) {
+            g_job_check_interval = g_profile.batch;
+            if (mining_backend_enabled() && !g_profile.device) {
+                printf("%s[INFO] The CPU threads alone are faster, not using the %s device%s\n",
+                    ANSI_COLOR_BLUE, config->compute_backend, ANSI_COLOR_RESET);
+                disable_mining_backend();
+            }
+        }
+    }
+    
+    // Create rewards directory if it doesn't exist
+    create_rewards_dir(config->rewards_dir);
+    
     // 打印报告服务器信息
     if (strlen(config->reporting.report_server) > 0) {
         printf("%s[INFO] Going to report to: %s/report%s\n", 
@@ -237,7 +704,6 @@ int main() {
     
     // Initialize thread data
     ThreadData thread_data = {
-        .config = config,
         .job = malloc(sizeof(Job)),
         .hash_count = malloc(sizeof(uint64_t)),
         .total_mined = malloc(sizeof(double)),
@@ -257,11 +723,8 @@ int main() {
     }
     memset(g_best_hash, 0xFF, 32); // Initialize with maximum value
     
-    // Initialize job
-    thread_data.job->seed = strdup("wait");
-    memset(thread_data.job->diff, 0, 32);
-    thread_data.job->reward = 0;
-    thread_data.job->last_found = 0;
+    // Initialize job, id 0 until the first one is published
+    memset(thread_data.job, 0, sizeof(Job));
     
     // Initialize counters
     *thread_data.hash_count = 0;
@@ -271,67 +734,160 @@ int main() {
     pthread_mutex_init(thread_data.job_mutex, NULL);
     
     // Determine number of threads
-    int thread_count = config->thread_count;
-    if (thread_count < 0) {
-        thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int thread_count = resolve_thread_count(config->thread_count);
+    // The device thread takes the metrics slot after the initial mining threads
+    bool use_device = mining_backend_enabled();
+    if (use_device) {
+        g_device_slot = thread_count;
+    }
+    printf("%s[INFO] Using %d threads%s%s\n", ANSI_COLOR_BLUE, thread_count,
+        use_device ? " and the OpenCL device" : "", ANSI_COLOR_RESET);
+    
+    if (!start_metrics_server(config->metrics_listen)) {
+        return 1;
+    }
+    
+    pthread_t signal_tid;
+    if (pthread_create(&signal_tid, NULL, signal_thread, &thread_data) != 0) {
+        printf("Failed to create signal thread\n");
+        return 1;
+    }
+    pthread_detach(signal_tid);
+    
+    if (strlen(config->job_record) > 0 && !job_record_open(config->job_record)) {
+        return 1;
+    }
+    if (strlen(config->job_log) > 0) {
+        char node[64] = "cminer";
+        if (strlen(config->worker_name) > 0) {
+            snprintf(node, sizeof(node), "%s", config->worker_name);
+        } else {
+            gethostname(node, sizeof(node) - 1);
+            node[sizeof(node) - 1] = '\0';
+        }
+        if (!job_log_open(config->job_log, node)) {
+            return 1;
+        }
+    }
+    
+    // Jobs come from the pool server, from the coordinator in worker mode or
+    // from a recorded stream. The pool starts filling once it is known which
+    // keys it should hold.
+    bool worker_mode = strlen(config->coordinator) > 0;
+    bool replay_mode = strlen(config->job_replay) > 0;
+    if (checkpointing && !start_checkpoints(config->checkpoint_file, config->checkpoint_interval)) {
+        return 1;
     }
-    if (thread_count > MAX_THREADS) {
-        thread_count = MAX_THREADS;
+    CoordinatorHandlers handlers = {
+        .on_job = on_external_job,
+        .on_solution = on_relayed_solution,
+        .ctx = &thread_data
+    };
+    if (worker_mode) {
+        if (!start_coordinator_worker(config, &handlers)) {
+            printf("Failed to start coordinator worker\n");
+            return 1;
+        }
+    } else if (strlen(config->coordinator_listen) > 0) {
+        if (!start_coordinator(config, &handlers)) {
+            return 1;
+        }
+    } else if (strlen(config->pool_seed) > 0) {
+        uint8_t base_key[32];
+        if (!pool_seed_base(config->pool_seed, base_key)) {
+            printf("Failed to derive pool from pool_seed\n");
+            return 1;
+        }
+        printf("%s[INFO] Deterministic pool from pool_seed%s\n", ANSI_COLOR_BLUE, ANSI_COLOR_RESET);
+        start_mining_pool(base_key);
+    } else {
+        start_mining_pool(NULL);
+    }
+    if (replay_mode && !start_job_replay(config, on_external_job, &thread_data)) {
+        printf("Failed to start job replay\n");
+        return 1;
+    }
+    bool poll_server = !worker_mode && !replay_mode;
+    if (poll_server && (set_job_servers(config->server) == 0 ||
+                        !start_server_health_checks(config->server_check_interval))) {
+        return 1;
     }
-    printf("%s[INFO] Using %d threads%s\n", ANSI_COLOR_BLUE, thread_count, ANSI_COLOR_RESET);
     
     // Create threads
-    pthread_t threads[MAX_THREADS + 4];  // +4 for job update, hash rate, best hash, and report threads
+    pthread_t threads[4];  // Job update, hash rate, best hash, and report threads
     
     // Create mining threads
-    for (int i = 0; i < thread_count; i++) {
-        if (pthread_create(&threads[i], NULL, mining_thread, &thread_data) != 0) {
-            printf("Failed to create mining thread %d\n", i);
+    pthread_mutex_lock(&g_reload_mutex);
+    int started = resize_mining_threads(&thread_data, thread_count);
+    pthread_mutex_unlock(&g_reload_mutex);
+    if (started < thread_count) {
+        return 1;
+    }
+    
+    if (use_device) {
+        static ThreadData device_data;
+        pthread_t device_tid;
+        device_data = thread_data;
+        device_data.thread_id = g_device_slot;
+        if (pthread_create(&device_tid, NULL, device_thread, &device_data) != 0) {
+            printf("Failed to create device thread\n");
             return 1;
         }
+        pthread_detach(device_tid);
     }
     
     // Create job update thread
-    if (pthread_create(&threads[thread_count], NULL, job_update_thread, &thread_data) != 0) {
+    if (poll_server && pthread_create(&threads[0], NULL, job_update_thread, &thread_data) != 0) {
         printf("Failed to create job update thread\n");
         return 1;
     }
     
     // Create hash rate thread
-    if (pthread_create(&threads[thread_count + 1], NULL, hash_rate_thread, &thread_data) != 0) {
+    if (pthread_create(&threads[1], NULL, hash_rate_thread, &thread_data) != 0) {
         printf("Failed to create hash rate thread\n");
         return 1;
     }
     
     // Create best hash thread
-    if (pthread_create(&threads[thread_count + 2], NULL, best_hash_thread, &thread_data) != 0) {
+    if (pthread_create(&threads[2], NULL, best_hash_thread, &thread_data) != 0) {
         printf("Failed to create best hash thread\n");
         return 1;
     }
     
     // Create report thread
-    if (pthread_create(&threads[thread_count + 3], NULL, report_thread, &thread_data) != 0) {
+    if (pthread_create(&threads[3], NULL, report_thread, &thread_data) != 0) {
         printf("Failed to create report thread\n");
         return 1;
     }
     
+    if (!start_control_server(config->control_listen, on_control_command, &thread_data)) {
+        return 1;
+    }
+    
     // Wait for threads
-    for (int i = 0; i < thread_count + 4; i++) {
+    for (int i = 0; i < 4; i++) {
+        if (!poll_server && i == 0) {
+            continue;
+        }
         pthread_join(threads[i], NULL);
     }
     
     // Cleanup
     pthread_mutex_destroy(thread_data.job_mutex);
     pthread_mutex_destroy(&g_hash_mutex);
-    if (thread_data.job->seed) {
-        free(thread_data.job->seed);
-    }
     free(thread_data.job);
     free(thread_data.hash_count);
     free(thread_data.total_mined);
     free(thread_data.job_mutex);
     free(g_best_hash);
-    free_config(config);
+    MinerConfig* last = atomic_load(&g_config);
+    if (last != g_startup_config) {
+        free_config(last);
+    }
+    for (int i = 0; i < g_retired_count; i++) {
+        free_config(g_retired[i].config);
+    }
+    free_config(g_startup_config);
     cleanup_mining();
     
     // Cleanup CURL
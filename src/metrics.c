@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "../include/miner.h"
+#include "../include/metrics.h"
+#include "../include/coordinator.h"
+#include "../include/servers.h"
+
+#define METRICS_BODY_SIZE (64 * 1024)
+
+MinerMetrics g_metrics;
+
+// Upper bounds in seconds; the last bucket is +Inf
+static const double job_switch_bounds[METRICS_HISTOGRAM_BUCKETS - 1] = {
+    0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0
+};
+static const double submit_bounds[METRICS_HISTOGRAM_BUCKETS - 1] = {
+    0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0
+};
+
+// Rendering buffers are static so that serving a scrape never allocates
+static char g_body[METRICS_BODY_SIZE];
+static char g_header[256];
+
+typedef struct {
+    char* buf;
+    size_t cap;
+    size_t len;
+} MetricsBuffer;
+
+static void observe(MetricsHistogram* h, const double* bounds, uint64_t elapsed_ns) {
+    double seconds = elapsed_ns / 1e9;
+    int i = 0;
+    while (i < METRICS_HISTOGRAM_BUCKETS - 1 && seconds > bounds[i]) i++;
+    atomic_fetch_add_explicit(&h->buckets[i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_ns, elapsed_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+}
+
+void metrics_observe_submit(uint64_t elapsed_ns) {
+    observe(&g_metrics.submit_latency, submit_bounds, elapsed_ns);
+}
+
+void metrics_observe_job_switch(uint64_t elapsed_ns) {
+    observe(&g_metrics.job_switch_latency, job_switch_bounds, elapsed_ns);
+}
+
+uint64_t metrics_total_hashes(void) {
+    uint64_t total = 0;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        total += atomic_load_explicit(&g_metrics.hashes[i].value, memory_order_relaxed);
+    }
+    return total;
+}
+
+// Called by the job update thread with the job mutex held
+void metrics_job_published(void) {
+    atomic_store(&g_metrics.job_hash_base, metrics_total_hashes());
+    atomic_store(&g_metrics.job_published_ns, metrics_now_ns());
+    atomic_fetch_add(&g_metrics.job_seq, 1);
+}
+
+static void emit(MetricsBuffer* b, const char* fmt, ...) {
+    if (b->len >= b->cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(b->buf + b->len, b->cap - b->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) {
+        b->len += (size_t)n;
+        if (b->len > b->cap) b->len = b->cap;
+    }
+}
+
+static void emit_counter(MetricsBuffer* b, const char* name, const char* help, uint64_t value) {
+    emit(b, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n", name, help, name, name, value);
+}
+
+static void emit_gauge(MetricsBuffer* b, const char* name, const char* help, double value) {
+    emit(b, "# HELP %s %s\n# TYPE %s gauge\n%s %.6g\n", name, help, name, name, value);
+}
+
+static void emit_histogram(MetricsBuffer* b, const char* name, const char* help,
+                           MetricsHistogram* h, const double* bounds) {
+    emit(b, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    uint64_t cumulative = 0;
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+        cumulative += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (i < METRICS_HISTOGRAM_BUCKETS - 1) {
+            emit(b, "%s_bucket{le=\"%g\"} %lu\n", name, bounds[i], cumulative);
+        } else {
+            emit(b, "%s_bucket{le=\"+Inf\"} %lu\n", name, cumulative);
+        }
+    }
+    emit(b, "%s_sum %.9f\n", name, atomic_load_explicit(&h->sum_ns, memory_order_relaxed) / 1e9);
+    emit(b, "%s_count %lu\n", name, atomic_load_explicit(&h->count, memory_order_relaxed));
+}
+
+static size_t render_metrics(void) {
+    MetricsBuffer b = {g_body, sizeof(g_body), 0};
+    int threads = atomic_load(&g_metrics.thread_count);
+
+    emit(&b, "# HELP cminer_hashes_total Hashes computed per mining thread.\n"
+             "# TYPE cminer_hashes_total counter\n");
+    for (int i = 0; i < threads && i < MAX_THREADS; i++) {
+        emit(&b, "cminer_hashes_total{thread=\"%d\"} %lu\n", i,
+             atomic_load_explicit(&g_metrics.hashes[i].value, memory_order_relaxed));
+    }
+    emit_gauge(&b, "cminer_mining_threads", "Number of mining threads.", atomic_load(&g_metrics.active_threads));
+
+    size_t pool_size, pool_capacity, pool_cursor;
+    get_keypair_pool_stats(&pool_size, &pool_capacity, &pool_cursor);
+    emit_gauge(&b, "cminer_pool_keypairs", "Keypairs generated and available for mining.", pool_size);
+    emit_gauge(&b, "cminer_pool_capacity_keypairs", "Keypair pool capacity.", pool_capacity);
+    emit_gauge(&b, "cminer_pool_cursor", "Index of the next keypair handed out.", pool_cursor);
+    emit_gauge(&b, "cminer_pool_memory_bytes", "Memory reserved for the keypair pool.",
+               (double)pool_capacity * sizeof(Keypair));
+
+    uint64_t job_seq = atomic_load(&g_metrics.job_seq);
+    emit_counter(&b, "cminer_jobs_total", "New jobs received from the server.", job_seq);
+    if (job_seq > 0) {
+        uint64_t age_ns = metrics_now_ns() - atomic_load(&g_metrics.job_published_ns);
+        uint64_t job_hashes = metrics_total_hashes() - atomic_load(&g_metrics.job_hash_base);
+        emit_gauge(&b, "cminer_job_age_seconds", "Time since the current job was received.", age_ns / 1e9);
+        emit_gauge(&b, "cminer_job_hashes", "Hashes computed against the current job.", job_hashes);
+        emit_gauge(&b, "cminer_pool_coverage_ratio",
+                   "Fraction of the pool hashed against the current job (>1 means the pool wrapped).",
+                   pool_size ? (double)job_hashes / pool_size : 0.0);
+    }
+    emit_histogram(&b, "cminer_job_switch_latency_seconds",
+                   "Delay between a job being published and a mining thread hashing it.",
+                   &g_metrics.job_switch_latency, job_switch_bounds);
+
+    int workers;
+    double worker_hashrate;
+    coordinator_stats(&workers, &worker_hashrate);
+    emit_gauge(&b, "cminer_coordinator_workers", "Workers connected to this coordinator.", workers);
+    emit_gauge(&b, "cminer_coordinator_worker_hashrate", "Hashes per second reported by connected workers.",
+               worker_hashrate);
+
+    JobServerStatus servers[MAX_JOB_SERVERS];
+    int server_count = job_server_status(servers, MAX_JOB_SERVERS);
+    emit(&b, "# HELP cminer_job_server_up Whether the last request to a job server succeeded.\n"
+             "# TYPE cminer_job_server_up gauge\n");
+    for (int i = 0; i < server_count; i++) {
+        emit(&b, "cminer_job_server_up{server=\"%s\",current=\"%d\"} %d\n",
+             servers[i].url, servers[i].current ? 1 : 0, servers[i].healthy ? 1 : 0);
+    }
+    emit(&b, "# HELP cminer_job_server_latency_seconds Smoothed job fetch round trip per server.\n"
+             "# TYPE cminer_job_server_latency_seconds gauge\n");
+    for (int i = 0; i < server_count; i++) {
+        emit(&b, "cminer_job_server_latency_seconds{server=\"%s\"} %.6f\n",
+             servers[i].url, servers[i].latency_ns / 1e9);
+    }
+
+    emit_histogram(&b, "cminer_submit_latency_seconds", "Solution submission round-trip time.",
+                   &g_metrics.submit_latency, submit_bounds);
+    emit(&b, "# HELP cminer_submits_total Solution submissions by outcome.\n"
+             "# TYPE cminer_submits_total counter\n");
+    emit(&b, "cminer_submits_total{outcome=\"accepted\"} %lu\n", atomic_load(&g_metrics.submits_accepted));
+    emit(&b, "cminer_submits_total{outcome=\"rejected\"} %lu\n", atomic_load(&g_metrics.submits_rejected));
+    emit(&b, "cminer_submits_total{outcome=\"failed\"} %lu\n", atomic_load(&g_metrics.submits_failed));
+
+    emit_counter(&b, "cminer_job_fetch_failures_total", "Failed job fetches.",
+                 atomic_load(&g_metrics.job_fetch_failures));
+    emit_counter(&b, "cminer_curl_errors_total", "CURL transfer errors.",
+                 atomic_load(&g_metrics.curl_errors));
+    emit_counter(&b, "cminer_report_failures_total", "Failed status reports.",
+                 atomic_load(&g_metrics.report_failures));
+
+    return b.len;
+}
+
+static void serve_client(int fd) {
+    char request[1024];
+    ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+    if (n <= 0) return;
+    request[n] = '\0';
+
+    if (strncmp(request, "GET /metrics", 12) != 0 && strncmp(request, "GET / ", 6) != 0) {
+        static const char not_found[] =
+            "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+
+    size_t body_len = render_metrics();
+    int header_len = snprintf(g_header, sizeof(g_header),
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n\r\n", body_len);
+    send_all(fd, g_header, (size_t)header_len);
+    send_all(fd, g_body, body_len);
+}
+
+static void* metrics_thread(void* arg) {
+    int listen_fd = (int)(intptr_t)arg;
+    struct timeval timeout = {1, 0};
+
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            // Out of descriptors: wait for some to be closed instead of spinning
+            if (errno != EINTR) usleep(100000);
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve_client(fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+bool start_metrics_server(const char* listen_addr) {
+    if (!listen_addr || strlen(listen_addr) == 0) {
+        return true;
+    }
+
+    int listen_fd = open_listener(listen_addr);
+    if (listen_fd < 0) {
+        printf("%s[ERROR] Failed to listen for metrics on %s%s\n", ANSI_COLOR_RED, listen_addr, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, metrics_thread, (void*)(intptr_t)listen_fd) != 0) {
+        close(listen_fd);
+        return false;
+    }
+    pthread_detach(thread);
+
+    printf("%s[INFO] Serving metrics on %s%s\n", ANSI_COLOR_BLUE, listen_addr, ANSI_COLOR_RESET);
+    return true;
+}
@@ -2,22 +2,59 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <openssl/evp.h>
+#include <stdatomic.h>
 #include <openssl/rand.h>
 #include <openssl/err.h>
 #include <secp256k1.h>
 #include "../include/miner.h"
 #include "../include/simd.h"
+#include "../include/trace.h"
+#include "../include/backend.h"
+#include "../include/keyset.h"
+
+// Smallest pool worth running with, even on a tiny memory budget
+#define MIN_POOL_KEYPAIRS 1024
+
+// Hit indices taken from one backend dispatch
+#define BACKEND_MAX_HITS 256
 
 static secp256k1_context* ctx = NULL;
 static KeypairPool* g_keypair_pool = NULL;
 
+// Optional compute backend, driven by a single device thread
+static ComputeBackend* g_backend = NULL;
+static size_t g_backend_batch = 0;
+static size_t g_backend_uploaded = 0;  // Pool prefix already on the device
+static uint32_t* g_backend_generations = NULL;  // batch_generation of each batch on the device
+static uint64_t g_backend_refreshed = 0;        // refreshed_batches when last compared
+static uint32_t g_backend_epoch = 0;            // Pool epoch the device contents belong to
+
+static int g_generator_threads = 1;
+static bool g_pool_refresh = false;
+
+// First word of g_best_hash, readable without the mutex for early rejection
+static _Atomic uint32_t g_best_word0 = UINT32_MAX;
+
+// Private keys already taken as solutions of job g_taken_job. Mining wraps
+// over the pool, and over the published prefix while it fills, so a key that
+// meets the difficulty comes around again on every lap.
+static KeySet g_taken_keys;
+static uint64_t g_taken_job = 0;
+static pthread_mutex_t g_taken_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 // 比较两个哈希值，返回 true 如果 hash1 小于 hash2
 static bool is_hash_better(const uint8_t* hash1, const uint8_t* hash2) {
     return compare_hash_simd(hash1, hash2) < 0;
 }
 
-void init_mining() {
+void reset_best_hash(void) {
+    pthread_mutex_lock(&g_hash_mutex);
+    memset(g_best_hash, 0xFF, 32);
+    atomic_store(&g_best_word0, UINT32_MAX);
+    pthread_mutex_unlock(&g_hash_mutex);
+}
+
+void init_mining(const MinerConfig* config) {
     // 初始化 OpenSSL 的随机数生成器
     RAND_seed(&ctx, sizeof(ctx)); // 使用 secp256k1 上下文作为种子
     RAND_seed(&time, sizeof(time_t)); // 使用当前时间作为种子
@@ -29,6 +66,12 @@ void init_mining() {
         exit(1);
     }
     
+    // Make sure the midstate/tail hashing path matches a reference SHA-256
+    if (!sha256_self_test()) {
+        printf("SHA-256 self test failed\n");
+        exit(1);
+    }
+    
     // Check and report AVX-512 support
     if (check_avx512_support()) {
         printf("AVX-512 support detected and enabled\n");
@@ -36,27 +79,154 @@ void init_mining() {
         printf("AVX-512 not supported, using scalar operations\n");
     }
     
-    // Create keypair pool (1GB worth of keypairs)
-    // Each keypair is 97 bytes (65 for public key + 32 for private key)
-    // 1GB = 1 * 1024 * 1024 * 1024 bytes
-    // Number of keypairs = 1GB / 97 bytes
-    size_t keypair_size = sizeof(Keypair); // 97 bytes
-    size_t num_keypairs = (1ULL * 1024 * 1024 * 1024) / keypair_size;
+    // Size the keypair pool from the configured memory budget
+    // Each keypair is 132 bytes (32 for the midstate, 65 for public key, 32 for private key, padding)
+    size_t keypair_size = sizeof(Keypair); // 132 bytes
+    size_t num_keypairs = config->pool_memory / keypair_size;
+    if (num_keypairs < MIN_POOL_KEYPAIRS) {
+        num_keypairs = MIN_POOL_KEYPAIRS;
+    }
     
-    printf("Creating keypair pool with capacity for %zu keypairs (%.2f GB)\n", 
-           num_keypairs, (double)num_keypairs * keypair_size / (1024 * 1024 * 1024));
+    double pool_mb = (double)num_keypairs * keypair_size / (1024 * 1024);
+    if (pool_mb >= 1024) {
+        printf("Creating keypair pool with capacity for %zu keypairs (%.2f GB)\n", num_keypairs, pool_mb / 1024);
+    } else {
+        printf("Creating keypair pool with capacity for %zu keypairs (%.1f MB)\n", num_keypairs, pool_mb);
+    }
     
-    g_keypair_pool = create_keypair_pool(num_keypairs);
+    g_keypair_pool = create_keypair_pool(num_keypairs, config->pool_backing, config->pool_shm_name);
     if (!g_keypair_pool) {
         printf("Failed to create keypair pool\n");
         exit(1);
     }
+    num_keypairs = g_keypair_pool->capacity;  // An existing shared pool keeps its size
     
-    // Pre-generate keypairs
-    pregenerate_keypairs(g_keypair_pool, num_keypairs);
+    if (strcmp(config->compute_backend, "opencl") == 0) {
+        g_backend = create_opencl_backend(config->opencl_device, num_keypairs);
+        if (!g_backend || !backend_self_test(g_backend, num_keypairs)) {
+            printf("Failed to initialize OpenCL backend\n");
+            exit(1);
+        }
+        g_backend_batch = config->opencl_batch;
+        g_backend_generations = calloc(g_keypair_pool->batch_count, sizeof(uint32_t));
+        if (!g_backend_generations) {
+            printf("Failed to initialize OpenCL backend\n");
+            exit(1);
+        }
+    } else if (strcmp(config->compute_backend, "cpu") != 0) {
+        printf("%s[WARN] Unknown compute_backend \"%s\", using cpu%s\n",
+            ANSI_COLOR_YELLOW, config->compute_backend, ANSI_COLOR_RESET);
+    }
+    
+    // Generation starts once it is known which keys the pool should hold
+    g_generator_threads = config->generator_threads;
+    if (g_generator_threads <= 0) {
+        g_generator_threads = get_available_cpus();
+    }
+    g_pool_refresh = config->pool_refresh;
+}
+
+size_t mining_pool_capacity(void) {
+    return g_keypair_pool ? g_keypair_pool->capacity : 0;
+}
+
+bool mining_pool_refreshing(void) {
+    return g_keypair_pool && g_keypair_pool->refresh;
+}
+
+size_t mining_pool_size(void) {
+    return g_keypair_pool ? atomic_load_explicit(g_keypair_pool->size, memory_order_acquire) : 0;
+}
+
+// Generate keypairs in the background, mining starts on the first batch.
+// A base key makes the pool the keyspace range base_key .. base_key + capacity - 1.
+void start_mining_pool(const uint8_t* base_key) {
+    if (!start_keypair_generation(g_keypair_pool, g_generator_threads, g_pool_refresh, base_key)) {
+        printf("Failed to start keypair generation\n");
+        exit(1);
+    }
+}
+
+// Rebuild the pool for a new keyspace range
+void restart_mining_pool(const uint8_t* base_key) {
+    if (!restart_keypair_generation(g_keypair_pool, g_generator_threads, g_pool_refresh, base_key)) {
+        printf("Failed to restart keypair generation\n");
+        exit(1);
+    }
+}
+
+bool mining_pool_base(uint8_t base_key[32], size_t* capacity) {
+    if (!g_keypair_pool || !g_keypair_pool->sequential) {
+        return false;
+    }
+    memcpy(base_key, g_keypair_pool->base_key, 32);
+    *capacity = g_keypair_pool->capacity;
+    return true;
+}
+
+size_t mining_pool_cursor(void) {
+    return g_keypair_pool ? atomic_load(g_keypair_pool->current_index) : 0;
+}
+
+void set_mining_pool_cursor(size_t cursor) {
+    if (g_keypair_pool) {
+        atomic_store(g_keypair_pool->current_index, cursor);
+        atomic_fetch_add_explicit(&g_keypair_pool->claim_epoch, 1, memory_order_release);
+    }
+}
+
+size_t mining_pool_in_flight(void) {
+    // Every mining thread can hold one claim, the device thread one dispatch
+    return (size_t)MAX_THREADS * KEYPAIR_CLAIM_SIZE + (g_backend ? g_backend_batch : 0);
+}
+
+bool mining_ready(void) {
+    return g_keypair_pool && atomic_load_explicit(g_keypair_pool->size, memory_order_acquire) > 0;
+}
+
+bool mining_backend_enabled(void) {
+    return g_backend != NULL;
+}
+
+static size_t g_backend_trial_size = 0;
+
+bool load_backend_trial(const Keypair* keypairs, size_t count) {
+    if (!g_backend) return false;
+    if (count > g_keypair_pool->capacity) {
+        count = g_keypair_pool->capacity;
+    }
+    // The fill uploads the real keypairs over these from index 0
+    if (!g_backend->upload(g_backend, keypairs, 0, count)) {
+        return false;
+    }
+    g_backend_trial_size = count;
+    return true;
+}
+
+uint64_t mine_backend_trial(const Job* job, size_t start) {
+    if (!g_backend || g_backend_trial_size == 0) return 0;
+    uint32_t hits[BACKEND_MAX_HITS];
+    size_t hit_count = 0;
+    if (!g_backend->search(g_backend, job, g_backend_trial_size, start % g_backend_trial_size,
+                           g_backend_batch, hits, BACKEND_MAX_HITS, &hit_count)) {
+        return 0;
+    }
+    return g_backend_batch;
+}
+
+void disable_mining_backend(void) {
+    if (g_backend) {
+        g_backend->destroy(g_backend);
+        g_backend = NULL;
+    }
+    free(g_backend_generations);
+    g_backend_generations = NULL;
+    g_backend_trial_size = 0;
 }
 
 void cleanup_mining() {
+    disable_mining_backend();
+    
     if (ctx) {
         secp256k1_context_destroy(ctx);
         ctx = NULL;
@@ -66,73 +236,127 @@ void cleanup_mining() {
         free_keypair_pool(g_keypair_pool);
         g_keypair_pool = NULL;
     }
+    
+    pthread_mutex_lock(&g_taken_mutex);
+    keyset_free(&g_taken_keys);
+    pthread_mutex_unlock(&g_taken_mutex);
 }
 
-static void sha256_hash(const uint8_t* input, size_t len, uint8_t* output) {
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    if (!ctx) {
-        printf("Failed to create EVP context\n");
-        exit(1);
-    }
+void get_keypair_pool_stats(size_t* size, size_t* capacity, size_t* cursor) {
+    *size = *capacity = *cursor = 0;
+    if (!g_keypair_pool) return;
 
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) != 1) {
-        printf("Failed to initialize SHA256\n");
-        EVP_MD_CTX_free(ctx);
-        exit(1);
-    }
+    *size = atomic_load(g_keypair_pool->size);
+    *capacity = g_keypair_pool->capacity;
+    *cursor = *size ? atomic_load(g_keypair_pool->current_index) % *size : 0;
+}
 
-    if (EVP_DigestUpdate(ctx, input, len) != 1) {
-        printf("Failed to update SHA256\n");
-        EVP_MD_CTX_free(ctx);
-        exit(1);
+// A refreshed pool slot can be rewritten while it is being hashed. Before a
+// solution is reported, make sure the keypair is consistent and really hits.
+static bool verify_candidate(const Job* job, const Keypair* keypair, const uint8_t hash[32]) {
+    secp256k1_pubkey pub;
+    uint8_t public_key[65];
+    size_t len = sizeof(public_key);
+    if (!secp256k1_ec_pubkey_create(ctx, &pub, keypair->private_key) ||
+        !secp256k1_ec_pubkey_serialize(ctx, public_key, &len, &pub, SECP256K1_EC_UNCOMPRESSED) ||
+        memcmp(public_key, keypair->public_key, sizeof(public_key)) != 0) {
+        return false;
     }
+    
+    uint32_t midstate[8];
+    uint32_t digest[8];
+    uint8_t expected[32];
+    sha256_pubkey_midstate(midstate, keypair->public_key);
+    sha256_tail_final(&job->tail, midstate, keypair->public_key[64], digest);
+    sha256_state_to_bytes(digest, expected);
+    return memcmp(expected, hash, 32) == 0;
+}
 
-    unsigned int digest_len;
-    if (EVP_DigestFinal_ex(ctx, output, &digest_len) != 1) {
-        printf("Failed to finalize SHA256\n");
-        EVP_MD_CTX_free(ctx);
-        exit(1);
+// Whether key is a new solution for job. A thread still on an older job
+// can't tell, its solution goes through.
+static bool first_taken(const Job* job, const uint8_t key[32]) {
+    bool first = true;
+    pthread_mutex_lock(&g_taken_mutex);
+    if (job->id > g_taken_job) {
+        keyset_clear(&g_taken_keys);
+        g_taken_job = job->id;
+    }
+    if (job->id == g_taken_job) {
+        first = keyset_insert(&g_taken_keys, key);
     }
+    pthread_mutex_unlock(&g_taken_mutex);
+    return first;
+}
 
-    EVP_MD_CTX_free(ctx);
+// Turn a hit into a solution, working from a copy of the pool slot
+static bool take_solution(const Job* job, const Keypair* keypair, const uint8_t hash[32], Solution* solution) {
+    Keypair snapshot = *keypair;
+    if (!verify_candidate(job, &snapshot, hash)) {
+        printf("%s[WARN] Discarding candidate from a keypair refreshed mid-hash%s\n",
+            ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+        return false;
+    }
+    if (!first_taken(job, snapshot.private_key)) {
+        return false;
+    }
+    memcpy_simd(solution->public_key, snapshot.public_key, 65);
+    memcpy_simd(solution->private_key, snapshot.private_key, 32);
+    
+    // Convert hash to hex string
+    char hash_hex[65];
+    hex_encode_simd(hash_hex, hash, 32);
+    hash_hex[64] = '\0';
+    solution->hash = strdup(hash_hex);
+    solution->reward = job->reward;
+    solution->server = job->server;
+    return true;
 }
 
-bool mine_block(const MinerConfig* config, Job* job, Solution* solution) {
+MineResult mine_block(const MinerConfig* config, Job* job, Solution* solution) {
     (void)config; // Unused parameter
     uint8_t hash[32];
-    char combined[1024];
-    bool found_solution = false;
     
     // Get a keypair from the pool
+    TRACE_BEGIN(fetch);
     Keypair* keypair = get_next_keypair(g_keypair_pool);
+    TRACE_END(fetch, TRACE_POOL_FETCH);
     if (!keypair) {
-        printf("Failed to get keypair from pool\n");
-        return false;
+        return MINE_STARVED;
     }
     
-    // Convert public key to hex string
-    char public_key_hex[131];  // 65 bytes * 2 chars per byte + null terminator
-    for (int i = 0; i < 65; i++) {
-        sprintf(public_key_hex + i*2, "%02x", keypair->public_key[i]);
-    }
-    public_key_hex[130] = '\0';
+    // Finish hex(public key) || seed from the keypair midstate and the job tail,
+    // but only as far as the first digest word
+    TRACE_BEGIN(hash);
+    uint32_t word0 = sha256_tail_word0(&job->tail, keypair->midstate, keypair->public_key[64]);
+    TRACE_END(hash, TRACE_HASH);
     
-    // Combine public key hex and seed
-    snprintf(combined, sizeof(combined), "%s%s", public_key_hex, job->seed);
+    // The first word decides almost every candidate. Only one that could meet
+    // the difficulty or beat the best hash gets its full digest computed.
+    TRACE_BEGIN(compare);
+    bool maybe_meets = word0 <= job->diff_words[0];
+    bool maybe_best = word0 <= atomic_load_explicit(&g_best_word0, memory_order_relaxed);
+    if (!maybe_meets && !maybe_best) {
+        TRACE_END(compare, TRACE_COMPARE);
+        return MINE_MISS;
+    }
     
-    // Calculate hash
-    sha256_hash((uint8_t*)combined, strlen(combined), hash);
+    uint32_t digest[8];
+    sha256_tail_final(&job->tail, keypair->midstate, keypair->public_key[64], digest);
+    sha256_state_to_bytes(digest, hash);
     
     // 更新最佳哈希值（如果当前哈希值更好）
-    pthread_mutex_lock(&g_hash_mutex);
-    if (is_hash_better(hash, g_best_hash)) {
-        memcpy_simd(g_best_hash, hash, 32);
+    if (maybe_best) {
+        pthread_mutex_lock(&g_hash_mutex);
+        if (is_hash_better(hash, g_best_hash)) {
+            memcpy_simd(g_best_hash, hash, 32);
+            atomic_store_explicit(&g_best_word0, digest[0], memory_order_relaxed);
+        }
+        pthread_mutex_unlock(&g_hash_mutex);
     }
-    pthread_mutex_unlock(&g_hash_mutex);
     
-    // Check if hash meets difficulty using SIMD comparison
-    bool meets_difficulty = true;
-    for (int i = 0; i < 32; i++) {
+    // Check if hash meets difficulty
+    bool meets_difficulty = maybe_meets;
+    for (int i = 0; meets_difficulty && i < 32; i++) {
         if (hash[i] != job->diff[i]) {
             // 当前字节不相等时判断难度
             if (hash[i] > job->diff[i]) {
@@ -141,22 +365,107 @@ bool mine_block(const MinerConfig* config, Job* job, Solution* solution) {
             break;
         }
     }
+    TRACE_END(compare, TRACE_COMPARE);
+    
+    if (meets_difficulty && take_solution(job, keypair, hash, solution)) {
+        return MINE_SOLVED;
+    }
+    return MINE_MISS;
+}
+
+size_t mine_backend_batch(const Job* job, Solution* solutions, size_t max_solutions, uint64_t* hashed) {
+    *hashed = 0;
+    // A rebuilt pool goes to the device from scratch. The epoch is read
+    // before the size, which a rebuild empties before bumping the epoch.
+    uint32_t epoch = atomic_load_explicit(&g_keypair_pool->epoch, memory_order_acquire);
+    size_t size = atomic_load_explicit(g_keypair_pool->size, memory_order_acquire);
+    if (!g_backend || size == 0) {
+        return 0;
+    }
+    if (epoch != g_backend_epoch) {
+        g_backend_uploaded = 0;
+        g_backend_epoch = epoch;
+    }
+    
+    // Send whatever the generators published since the last dispatch
+    if (size > g_backend_uploaded) {
+        if (!g_backend->upload(g_backend, g_keypair_pool->keypairs, g_backend_uploaded, size - g_backend_uploaded)) {
+            return 0;
+        }
+        g_backend_uploaded = size;
+    }
     
-    if (meets_difficulty) {
-        memcpy_simd(solution->public_key, keypair->public_key, 65);
-        memcpy_simd(solution->private_key, keypair->private_key, 32);
-        
-        // Convert hash to hex string
-        char hash_hex[65];
-        for (int i = 0; i < 32; i++) {
-            sprintf(hash_hex + i*2, "%02x", hash[i]);
+    // With pool_refresh, batches already on the device get rewritten. Hits on
+    // a stale copy would fail verification, so send those batches again.
+    uint64_t refreshed = atomic_load_explicit(g_keypair_pool->refreshed_batches, memory_order_acquire);
+    if (refreshed != g_backend_refreshed) {
+        bool complete = true;
+        for (size_t batch = 0; batch < g_keypair_pool->batch_count; batch++) {
+            uint32_t generation = atomic_load_explicit(&g_keypair_pool->batch_generation[batch], memory_order_acquire);
+            size_t first = batch * GEN_BATCH_SIZE;
+            if (generation == g_backend_generations[batch]) continue;
+            if (first >= size) {
+                complete = false;  // Refreshed before its first fill was published
+                continue;
+            }
+            
+            size_t count = first + GEN_BATCH_SIZE < size ? GEN_BATCH_SIZE : size - first;
+            if (!g_backend->upload(g_backend, g_keypair_pool->keypairs, first, count)) {
+                return 0;
+            }
+            g_backend_generations[batch] = generation;
+        }
+        if (complete) {
+            g_backend_refreshed = refreshed;
+        }
+    }
+    
+    // Shares the pool cursor with the CPU mining threads. While the pool fills,
+    // only the published keypairs not claimed yet are taken, never a wrap.
+    size_t count = g_backend_batch;
+    size_t start = atomic_load_explicit(g_keypair_pool->current_index, memory_order_relaxed);
+    if (size < g_keypair_pool->capacity) {
+        do {
+            size_t index = start % g_keypair_pool->capacity;
+            if (index >= size) {
+                return 0;
+            }
+            count = size - index < g_backend_batch ? size - index : g_backend_batch;
+        } while (!atomic_compare_exchange_weak_explicit(g_keypair_pool->current_index, &start, start + count,
+                                                        memory_order_relaxed, memory_order_relaxed));
+    } else {
+        start = atomic_fetch_add_explicit(g_keypair_pool->current_index, count, memory_order_relaxed);
+    }
+    uint32_t hits[BACKEND_MAX_HITS];
+    size_t hit_count = 0;
+    TRACE_BEGIN(hash);
+    bool searched = g_backend->search(g_backend, job, size, start % size, count, hits, BACKEND_MAX_HITS, &hit_count);
+    TRACE_END(hash, TRACE_HASH);
+    if (!searched) {
+        return 0;
+    }
+    *hashed = count;
+    
+    if (hit_count > BACKEND_MAX_HITS) {
+        printf("%s[WARN] %zu device hits in one batch, dropping %zu%s\n",
+            ANSI_COLOR_YELLOW, hit_count, hit_count - BACKEND_MAX_HITS, ANSI_COLOR_RESET);
+        hit_count = BACKEND_MAX_HITS;
+    }
+    
+    // Every device hit is rehashed here before it becomes a solution
+    size_t found = 0;
+    for (size_t i = 0; i < hit_count && found < max_solutions; i++) {
+        const Keypair* keypair = &g_keypair_pool->keypairs[hits[i]];
+        uint32_t digest[8];
+        uint8_t hash[32];
+        sha256_tail_final(&job->tail, keypair->midstate, keypair->public_key[64], digest);
+        sha256_state_to_bytes(digest, hash);
+        if (compare_hash_simd(hash, job->diff) <= 0 && take_solution(job, keypair, hash, &solutions[found])) {
+            found++;
         }
-        solution->hash = strdup(hash_hex);
-        solution->reward = job->reward;
-        found_solution = true;
     }
     
-    return found_solution;
+    return found;
 }
 
 void print_hash_rate(uint64_t hash_count) {
@@ -195,10 +504,11 @@ void save_reward(const MinerConfig* config, const Solution* solution, uint64_t c
     }
     
     // Save private key
-    for (int i = 0; i < 32; i++) {
-        fprintf(fp, "%02x", solution->private_key[i]);
-    }
-    fprintf(fp, "\n");
+    char private_key_hex[66];
+    hex_encode_simd(private_key_hex, solution->private_key, 32);
+    private_key_hex[64] = '\n';
+    private_key_hex[65] = '\0';
+    fputs(private_key_hex, fp);
     
     fclose(fp);
     
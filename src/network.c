@@ -3,137 +3,348 @@
 #include <string.h>
 #include <curl/curl.h>
 #include "../include/miner.h"
+#include "../include/metrics.h"
+#include "../include/simd.h"
+#include "../include/servers.h"
 #include <openssl/sha.h>
 #include <secp256k1.h>
 
-struct MemoryStruct {
-    char* memory;
-    size_t size;
+// A slow job server must not keep the miners on a stale seed for long
+#define JOB_FETCH_TIMEOUT 5L
+#define SUBMIT_TIMEOUT 30L
+
+// Submit responses are a short status message, anything longer is cut
+#define SUBMIT_RESPONSE_SIZE 1024
+
+bool job_set_seed(Job* job, const char* seed, size_t seed_len) {
+    if (seed_len > MAX_SEED_LEN) {
+        return false;
+    }
+    memcpy(job->seed, seed, seed_len);
+    job->seed[seed_len] = '\0';
+    job->seed_len = seed_len;
+    return true;
+}
+
+bool job_set_diff(Job* job, const char* hex, size_t hex_len) {
+    if (hex_len != 64 || !hex_decode_simd(job->diff, hex, 32)) {
+        return false;
+    }
+    for (int i = 0; i < 8; i++) {
+        job->diff_words[i] = ((uint32_t)job->diff[i * 4] << 24) |
+                             ((uint32_t)job->diff[i * 4 + 1] << 16) |
+                             ((uint32_t)job->diff[i * 4 + 2] << 8) |
+                             job->diff[i * 4 + 3];
+    }
+    return true;
+}
+
+// Streaming parser for the get-challenge object. It runs in the curl write
+// callback and stores the fields straight into the caller's job, so a fetch
+// buffers nothing but the value being read. Only top-level fields are used.
+typedef enum {
+    JSON_BETWEEN,    // Between tokens
+    JSON_KEY,        // Inside a top-level key
+    JSON_STRING,     // Inside a string value
+    JSON_LITERAL     // Inside a number, true, false or null
+} JsonState;
+
+typedef struct {
+    Job* job;
+    JsonState state;
+    int depth;
+    bool want_key;            // The next top-level string is a key
+    bool escape;              // Previous string char was a backslash
+    bool escaped;             // The current string has an escape sequence
+    char key[16];
+    size_t key_len;
+    char value[MAX_SEED_LEN + 1];
+    size_t value_len;
+    bool value_overflow;
+    bool has_seed;
+    bool has_diff;
+    bool seed_too_long;
+    bool seed_escaped;
+} JobParser;
+
+static void parser_append(JobParser* parser, char c) {
+    if (parser->state == JSON_KEY) {
+        if (parser->key_len < sizeof(parser->key) - 1) {
+            parser->key[parser->key_len++] = c;
+        }
+        return;
+    }
+    if (parser->value_len < sizeof(parser->value) - 1) {
+        parser->value[parser->value_len++] = c;
+    } else {
+        parser->value_overflow = true;
+    }
+}
+
+// A complete top-level value for parser->key
+static void parser_field(JobParser* parser, bool is_string) {
+    Job* job = parser->job;
+    parser->key[parser->key_len] = '\0';
+    parser->value[parser->value_len] = '\0';
+
+    if (is_string && strcmp(parser->key, "seed") == 0) {
+        parser->seed_escaped = parser->escaped;
+        parser->seed_too_long = !parser->escaped && (parser->value_overflow ||
+                                !job_set_seed(job, parser->value, parser->value_len));
+        parser->has_seed = !parser->escaped && !parser->seed_too_long;
+    } else if (is_string && strcmp(parser->key, "diff") == 0) {
+        parser->has_diff = !parser->escaped && !parser->value_overflow &&
+                           job_set_diff(job, parser->value, parser->value_len);
+    } else if (!is_string && strcmp(parser->key, "reward") == 0) {
+        job->reward = atof(parser->value);
+    } else if (!is_string && strcmp(parser->key, "lastFound") == 0) {
+        job->last_found = strtoull(parser->value, NULL, 10);
+    }
+}
+
+static void parser_feed(JobParser* parser, const char* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+
+        if (parser->state == JSON_KEY || parser->state == JSON_STRING) {
+            if (parser->escape) {
+                parser->escape = false;
+                parser_append(parser, c);
+            } else if (c == '\\') {
+                // Seed and diff are plain ASCII, which servers send unescaped.
+                // The backslash is kept so an escaped key matches no field,
+                // and an escaped seed or diff is rejected, not decoded.
+                parser->escape = true;
+                parser->escaped = true;
+                parser_append(parser, c);
+            } else if (c == '"') {
+                if (parser->state == JSON_STRING && parser->depth == 1) {
+                    parser_field(parser, true);
+                }
+                parser->state = JSON_BETWEEN;
+            } else {
+                parser_append(parser, c);
+            }
+            continue;
+        }
+
+        if (parser->state == JSON_LITERAL) {
+            if (strchr("0123456789+-.eEtrufalsn", c) && c != '\0') {
+                parser_append(parser, c);
+                continue;
+            }
+            if (parser->depth == 1) {
+                parser_field(parser, false);
+            }
+            parser->state = JSON_BETWEEN;
+        }
+
+        switch (c) {
+            case '{':
+            case '[':
+                parser->depth++;
+                parser->want_key = c == '{';
+                break;
+            case '}':
+            case ']':
+                parser->depth--;
+                break;
+            case ',':
+                parser->want_key = true;
+                break;
+            case ':':
+                parser->want_key = false;
+                break;
+            case '"':
+                if (parser->want_key && parser->depth == 1) {
+                    parser->state = JSON_KEY;
+                    parser->key_len = 0;
+                } else {
+                    parser->state = JSON_STRING;
+                }
+                parser->value_len = 0;
+                parser->value_overflow = false;
+                parser->escaped = false;
+                break;
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                break;
+            default:
+                parser->state = JSON_LITERAL;
+                parser->value_len = 0;
+                parser->value_overflow = false;
+                parser_append(parser, c);
+                break;
+        }
+    }
+}
+
+// Documents for job_parser_self_test. seed is the one expected, NULL if the
+// seed must be rejected.
+typedef struct {
+    const char* json;
+    const char* seed;
+    bool diff;
+} ParserCase;
+
+#define TEST_DIFF_TAIL "0000fff" "ffffffffffffffffffffffffffffffffffffffffffffffffffffffff"
+#define TEST_DIFF "0" TEST_DIFF_TAIL
+
+static const ParserCase parser_cases[] = {
+    // Fields of nested objects and arrays, and quotes inside strings, are not top-level fields
+    {"{\"note\": {\"seed\": \"nested\", \"diff\": [1, {\"x\": \"y\"}]}, \"seed\": \"abc123\", "
+     "\"list\": [\"\\\"seed\\\": \\\"x\", 2, null], \"reward\": 1.5, \"diff\": \"" TEST_DIFF "\", "
+     "\"lastFound\": 123}", "abc123", true},
+    // Escapes in seed and diff, which would read as valid values with the backslash dropped
+    {"{\"seed\": \"ab\\c\", \"diff\": \"" TEST_DIFF "\"}", NULL, true},
+    {"{\"seed\": \"abc\", \"diff\": \"\\0" TEST_DIFF_TAIL "\"}", "abc", false},
+    {"{\"seed\": \"a\\u0062c\", \"diff\": \"" TEST_DIFF "\"}", NULL, true},
+    // An escaped key is not the field it decodes to
+    {"{\"se\\u0065d\": \"wrong\", \"seed\": \"right\", \"diff\": \"" TEST_DIFF "\"}", "right", true},
 };
 
-static size_t WriteMemoryCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-    size_t realsize = size * nmemb;
-    struct MemoryStruct* mem = (struct MemoryStruct*)userp;
+// Parse json delivered in two chunks split at split, or one byte at a time
+static bool parser_case_ok(const ParserCase* test, size_t split, bool bytewise) {
+    Job job = {0};
+    JobParser parser = {.job = &job, .state = JSON_BETWEEN};
+    size_t len = strlen(test->json);
+    if (bytewise) {
+        for (size_t i = 0; i < len; i++) {
+            parser_feed(&parser, test->json + i, 1);
+        }
+    } else {
+        parser_feed(&parser, test->json, split);
+        parser_feed(&parser, test->json + split, len - split);
+    }
+
+    if (test->seed ? !parser.has_seed || strcmp(job.seed, test->seed) != 0 : parser.has_seed) {
+        return false;
+    }
+    if (parser.has_diff != test->diff || (test->diff && job.diff_words[0] != 0x00000fff)) {
+        return false;
+    }
+    // The first case carries the numeric fields too
+    if (test == &parser_cases[0] && (job.reward != 1.5 || job.last_found != 123)) {
+        return false;
+    }
+    return true;
+}
 
-    char* ptr = realloc(mem->memory, mem->size + realsize + 1);
-    if (!ptr) {
-        printf("Failed to allocate memory\n");
-        return 0;
+bool job_parser_self_test(void) {
+    for (size_t t = 0; t < sizeof(parser_cases) / sizeof(parser_cases[0]); t++) {
+        size_t len = strlen(parser_cases[t].json);
+        for (size_t split = 0; split <= len; split++) {
+            if (!parser_case_ok(&parser_cases[t], split, false)) {
+                printf("JSON parser self test failed for case %zu split at %zu\n", t, split);
+                return false;
+            }
+        }
+        if (!parser_case_ok(&parser_cases[t], 0, true)) {
+            printf("JSON parser self test failed for case %zu fed bytewise\n", t);
+            return false;
+        }
     }
+    return true;
+}
+
+static size_t job_write_callback(char* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realsize = size * nmemb;
+    parser_feed((JobParser*)userp, contents, realsize);
+    return realsize;
+}
+
+// Fixed-size response buffer, the tail of an oversized response is dropped
+typedef struct {
+    char* data;
+    size_t size;
+    size_t len;
+} ResponseBuffer;
 
-    mem->memory = ptr;
-    memcpy(&(mem->memory[mem->size]), contents, realsize);
-    mem->size += realsize;
-    mem->memory[mem->size] = 0;
+static size_t response_write_callback(char* contents, size_t size, size_t nmemb, void* userp) {
+    size_t realsize = size * nmemb;
+    ResponseBuffer* buffer = (ResponseBuffer*)userp;
+
+    size_t room = buffer->size - 1 - buffer->len;
+    size_t copy = realsize < room ? realsize : room;
+    memcpy(buffer->data + buffer->len, contents, copy);
+    buffer->len += copy;
+    buffer->data[buffer->len] = '\0';
 
     return realsize;
 }
 
-static char* make_request(const char* url) {
-    CURL* curl = curl_easy_init();
+// GET url, passing the body to write_callback. handle is reused when given,
+// so repeated requests to a server keep their connection.
+static bool make_request(CURL* handle, const char* url, long timeout,
+                         curl_write_callback write_callback, void* write_data) {
+    CURL* curl = handle ? handle : curl_easy_init();
     if (!curl) {
         printf("Failed to initialize CURL\n");
-        return NULL;
-    }
-
-    struct MemoryStruct chunk = {malloc(1), 0};
-    if (!chunk.memory) {
-        curl_easy_cleanup(curl);
-        return NULL;
+        return false;
     }
 
     curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&chunk);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, write_data);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
     curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
 
     CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
+    if (!handle) {
+        curl_easy_cleanup(curl);
+    }
 
     if (res != CURLE_OK) {
+        metrics_inc(&g_metrics.curl_errors);
         printf("CURL error: %s\n", curl_easy_strerror(res));
-        free(chunk.memory);
-        return NULL;
+        return false;
     }
 
-    return chunk.memory;
+    return true;
 }
 
-Job* get_job(const char* server_url) {
+bool get_job(const char* server_url, Job* job) {
+    // One handle per fetching thread, they live as long as the process
+    static __thread CURL* curl = NULL;
+    if (!curl) {
+        curl = curl_easy_init();
+    }
+
     char url[1024];
     snprintf(url, sizeof(url), "%s/get-challenge", server_url);
 
-    char* response = make_request(url);
-    if (!response) {
+    job->server = NULL;
+    job->reward = 0;
+    job->last_found = 0;
+    JobParser parser = {.job = job, .state = JSON_BETWEEN};
+    if (!curl || !make_request(curl, url, JOB_FETCH_TIMEOUT, job_write_callback, &parser)) {
+        metrics_inc(&g_metrics.job_fetch_failures);
         printf("Failed to get job from server: %s\n", server_url);
-        return NULL;
-    }
-
-    // Parse JSON response (simplified version)
-    Job* job = malloc(sizeof(Job));
-    if (!job) {
-        free(response);
-        return NULL;
-    }
-
-    // Initialize job structure
-    job->seed = NULL;
-
-    // Extract seed
-    char* seed_start = strstr(response, "\"seed\":\"");
-    if (seed_start) {
-        seed_start += 8;
-        char* seed_end = strchr(seed_start, '"');
-        if (seed_end) {
-            size_t seed_len = seed_end - seed_start;
-            job->seed = malloc(seed_len + 1);
-            if (job->seed) {
-                strncpy(job->seed, seed_start, seed_len);
-                job->seed[seed_len] = '\0';
-            }
-        }
-    }
-
-    // Extract difficulty
-    char* diff_start = strstr(response, "\"diff\":\"");
-    if (diff_start) {
-        diff_start += 8;
-        char* diff_end = strchr(diff_start, '"');
-        if (diff_end) {
-            size_t diff_len = diff_end - diff_start;
-            char diff_hex[65] = {0};
-            strncpy(diff_hex, diff_start, diff_len < 64 ? diff_len : 64);
-            // Convert hex to bytes
-            for (int i = 0; i < 32; i++) {
-                sscanf(diff_hex + i*2, "%02hhx", &job->diff[i]);
-            }
-        }
+        return false;
     }
 
-    // Extract reward
-    char* reward_start = strstr(response, "\"reward\":");
-    if (reward_start) {
-        job->reward = atof(reward_start + 9);
+    // Validate job
+    if (parser.seed_escaped) {
+        printf("Invalid job response: escape sequence in seed\n");
+        return false;
     }
-
-    // Extract last_found
-    char* last_found_start = strstr(response, "\"lastFound\":");
-    if (last_found_start) {
-        job->last_found = strtoull(last_found_start + 12, NULL, 10);
+    if (parser.seed_too_long) {
+        printf("Invalid job response: seed longer than %d chars\n", MAX_SEED_LEN);
+        return false;
     }
-
-    free(response);
-
-    // Validate job
-    if (!job->seed) {
+    if (!parser.has_seed) {
         printf("Invalid job response: missing seed\n");
-        free(job);
-        return NULL;
+        return false;
+    }
+    if (!parser.has_diff) {
+        printf("Invalid job response: bad diff\n");
+        return false;
     }
 
-    return job;
+    return true;
 }
 
 bool submit_solution(const MinerConfig* config, const Solution* solution) {
@@ -143,36 +354,27 @@ bool submit_solution(const MinerConfig* config, const Solution* solution) {
     char signature[145]; // For DER format signature
 
     // Convert solution's public key to hex
-    for (int i = 0; i < 65; i++) {
-        sprintf(public_key_hex + i*2, "%02x", solution->public_key[i]);
-    }
+    hex_encode_simd(public_key_hex, solution->public_key, 65);
     public_key_hex[130] = '\0';
 
     // Convert solution's private key to hex
-    for (int i = 0; i < 32; i++) {
-        sprintf(private_key_hex + i*2, "%02x", solution->private_key[i]);
-    }
+    hex_encode_simd(private_key_hex, solution->private_key, 32);
     private_key_hex[64] = '\0';
-
-    // Convert private key from hex to bytes for signing
-    unsigned char privkey_bytes[32];
-    for (int i = 0; i < 32; i++) {
-        sscanf(private_key_hex + i*2, "%02hhx", &privkey_bytes[i]);
-    }
     
     // 1. Hash the hex-encoded public key with SHA-256
     unsigned char hash[32];
     SHA256_CTX sha256;
     SHA256_Init(&sha256);
-    SHA256_Update(&sha256, public_key_hex, strlen(public_key_hex));
+    SHA256_Update(&sha256, public_key_hex, 130);
     SHA256_Final(hash, &sha256);
     
     // 2. Sign the hash with the private key using ECDSA
     secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
     secp256k1_ecdsa_signature sig;
     
-    if (!secp256k1_ecdsa_sign(ctx, &sig, hash, privkey_bytes, NULL, NULL)) {
+    if (!secp256k1_ecdsa_sign(ctx, &sig, hash, solution->private_key, NULL, NULL)) {
         printf("%s[ERROR] Failed to sign hash%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        metrics_inc(&g_metrics.submits_failed);
         secp256k1_context_destroy(ctx);
         return false;
     }
@@ -183,44 +385,62 @@ bool submit_solution(const MinerConfig* config, const Solution* solution) {
     
     if (!secp256k1_ecdsa_signature_serialize_der(ctx, sig_der, &der_len, &sig)) {
         printf("%s[ERROR] Failed to serialize signature%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        metrics_inc(&g_metrics.submits_failed);
         secp256k1_context_destroy(ctx);
         return false;
     }
     
     // Convert signature to hex
-    for (int i = 0; i < der_len; i++) {
-        sprintf(signature + i*2, "%02x", sig_der[i]);
-    }
+    hex_encode_simd(signature, sig_der, der_len);
     signature[der_len*2] = '\0';
     
     secp256k1_context_destroy(ctx);
 
+    char query[1536];
     if (strlen(config->pool_secret) > 0) {
-        snprintf(url, sizeof(url), 
-            "%s/challenge-solved?holder=%s&sign=%s&hash=%s&poolsecret=%s&key=%s",
-            config->server, public_key_hex, signature, solution->hash,
+        snprintf(query, sizeof(query), 
+            "challenge-solved?holder=%s&sign=%s&hash=%s&poolsecret=%s&key=%s",
+            public_key_hex, signature, solution->hash,
             config->pool_secret, private_key_hex);
         // Print submission information
         printf("%s[INFO] Submitting solution to pool%s\n", ANSI_COLOR_BLUE, ANSI_COLOR_RESET);
     } else {
-        snprintf(url, sizeof(url), 
-            "%s/challenge-solved?holder=%s&sign=%s&hash=%s",
-            config->server, public_key_hex, signature, solution->hash);
+        snprintf(query, sizeof(query), 
+            "challenge-solved?holder=%s&sign=%s&hash=%s",
+            public_key_hex, signature, solution->hash);
         printf("%s[INFO] Submitting solution%s\n", ANSI_COLOR_BLUE, ANSI_COLOR_RESET);
     }
 
-    char* response = make_request(url);
-    if (!response) {
+    // Submit to the server that issued the job
+    const char* server = solution->server ? solution->server : current_job_server();
+    snprintf(url, sizeof(url), "%s/%s", server, query);
+    uint64_t submit_start = metrics_now_ns();
+    char response[SUBMIT_RESPONSE_SIZE] = "";
+    ResponseBuffer buffer = {response, sizeof(response), 0};
+    bool sent = make_request(NULL, url, SUBMIT_TIMEOUT, response_write_callback, &buffer);
+    
+    // If it went away since, the server jobs come from now is the next best
+    const char* fallback = current_job_server();
+    if (!sent && fallback && fallback != server) {
+        printf("%s[WARN] %s unreachable, submitting to %s%s\n", ANSI_COLOR_YELLOW, server, fallback, ANSI_COLOR_RESET);
+        snprintf(url, sizeof(url), "%s/%s", fallback, query);
+        buffer.len = 0;
+        response[0] = '\0';
+        sent = make_request(NULL, url, SUBMIT_TIMEOUT, response_write_callback, &buffer);
+    }
+    metrics_observe_submit(metrics_now_ns() - submit_start);
+    if (!sent) {
         printf("%s[ERROR] Failed to submit solution%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        metrics_inc(&g_metrics.submits_failed);
         return false;
     }
 
     bool success = strstr(response, "success") != NULL;
+    metrics_inc(success ? &g_metrics.submits_accepted : &g_metrics.submits_rejected);
     if (!success) {
         printf("%s[ERROR] Server response: %s%s\n", ANSI_COLOR_RED, response, ANSI_COLOR_RESET);
     } else {
         printf("%s[INFO] Solution submitted successfully%s\n", ANSI_COLOR_GREEN, ANSI_COLOR_RESET);
     }
-    free(response);
     return success;
 } 
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <openssl/evp.h>
+#include <secp256k1.h>
+#include "../include/miner.h"
+#include "../include/replay.h"
+#include "../include/joblog.h"
+#include "../include/metrics.h"
+#include "../include/simd.h"
+
+#define JOB_STREAM_HEADER "# cminer job stream v1\n"
+#define JOB_LINE_SIZE 1024
+
+static FILE* g_record = NULL;
+static uint64_t g_record_start_ns = 0;
+static pthread_mutex_t g_record_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    const MinerConfig* config;
+    void (*publish)(void* ctx, Job* job);
+    void* ctx;
+} ReplayContext;
+
+static ReplayContext g_replay;
+
+bool job_record_open(const char* path) {
+    g_record = fopen(path, "w");
+    if (!g_record) {
+        printf("%s[ERROR] Cannot open job record file %s%s\n", ANSI_COLOR_RED, path, ANSI_COLOR_RESET);
+        return false;
+    }
+    fputs(JOB_STREAM_HEADER, g_record);
+    fflush(g_record);
+    printf("%s[INFO] Recording jobs to %s%s\n", ANSI_COLOR_BLUE, path, ANSI_COLOR_RESET);
+    return true;
+}
+
+void job_record_append(const Job* job) {
+    if (!g_record) return;
+
+    char diff_hex[65];
+    hex_encode_simd(diff_hex, job->diff, 32);
+    diff_hex[64] = '\0';
+
+    pthread_mutex_lock(&g_record_mutex);
+    uint64_t now = metrics_now_ns();
+    if (g_record_start_ns == 0) {
+        g_record_start_ns = now;
+    }
+    fprintf(g_record, "%" PRIu64 " %s %.8f %" PRIu64 " %s\n",
+            (now - g_record_start_ns) / 1000000, diff_hex, job->reward, job->last_found, job->seed);
+    fflush(g_record);
+    pthread_mutex_unlock(&g_record_mutex);
+}
+
+// Parse one job line into job, returns false for malformed lines
+static bool parse_job_line(char* line, uint64_t* at_ms, Job* job) {
+    char diff_hex[65] = "";
+    double reward = 0;
+    uint64_t last_found = 0;
+    int seed_offset = 0;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    if (sscanf(line, "%" SCNu64 " %64s %lf %" SCNu64 " %n", at_ms, diff_hex, &reward, &last_found, &seed_offset) != 4 ||
+        seed_offset == 0 || strlen(diff_hex) != 64) {
+        return false;
+    }
+
+    const char* seed = line + seed_offset;
+    job->reward = reward;
+    job->last_found = last_found;
+    job->server = NULL;
+    return job_set_seed(job, seed, strlen(seed)) && job_set_diff(job, diff_hex, 64);
+}
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL)};
+    nanosleep(&ts, NULL);
+}
+
+static void* replay_thread(void* arg) {
+    (void)arg;
+    const MinerConfig* config = g_replay.config;
+    double speed = config->replay_speed > 0 ? config->replay_speed : 1.0;
+    char line[JOB_LINE_SIZE];
+    static Job job;
+
+    FILE* fp = fopen(config->job_replay, "r");
+    if (!fp) {
+        printf("%s[ERROR] Cannot open job stream %s%s\n", ANSI_COLOR_RED, config->job_replay, ANSI_COLOR_RESET);
+        exit(1);
+    }
+
+    // Measure hashing, not pool generation
+    size_t size, capacity, cursor;
+    do {
+        usleep(100000);
+        get_keypair_pool_stats(&size, &capacity, &cursor);
+    } while (capacity == 0 || size < capacity);
+    printf("%s[INFO] Replaying %s at %.2fx%s\n", ANSI_COLOR_BLUE, config->job_replay, speed, ANSI_COLOR_RESET);
+
+    uint64_t start_ns = metrics_now_ns();
+    uint64_t start_hashes = metrics_total_hashes();
+    uint64_t previous_ms = 0;
+    uint64_t last_gap_ms = 0;
+    int jobs = 0;
+    int line_no = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n') continue;
+
+        uint64_t at_ms;
+        if (!parse_job_line(line, &at_ms, &job)) {
+            printf("%s[WARN] Skipping malformed job on line %d%s\n", ANSI_COLOR_YELLOW, line_no, ANSI_COLOR_RESET);
+            continue;
+        }
+
+        // Jobs keep their recorded spacing relative to the start of the replay
+        uint64_t due_ns = start_ns + (uint64_t)(at_ms * 1e6 / speed);
+        uint64_t now = metrics_now_ns();
+        if (due_ns > now) {
+            sleep_ns(due_ns - now);
+        }
+        if (jobs > 0) {
+            last_gap_ms = at_ms - previous_ms;
+        }
+        previous_ms = at_ms;
+        jobs++;
+        g_replay.publish(g_replay.ctx, &job);
+    }
+    fclose(fp);
+
+    // Give the last job as long as the one before it
+    sleep_ns((uint64_t)(last_gap_ms * 1e6 / speed));
+
+    double elapsed = (metrics_now_ns() - start_ns) / 1e9;
+    uint64_t hashes = metrics_total_hashes() - start_hashes;
+    uint64_t switches = atomic_load(&g_metrics.job_switch_latency.count);
+    double switch_mean_us = switches ? atomic_load(&g_metrics.job_switch_latency.sum_ns) / 1e3 / switches : 0;
+    printf("\n%s[INFO] Replay finished: %d jobs in %.2fs, %" PRIu64 " hashes (%.0f H/s), "
+           "mean job switch %.1f us over %" PRIu64 " switches%s\n",
+           ANSI_COLOR_GREEN, jobs, elapsed, hashes, elapsed > 0 ? hashes / elapsed : 0.0,
+           switch_mean_us, switches, ANSI_COLOR_RESET);
+    job_log_close();
+    exit(0);
+    return NULL;
+}
+
+bool start_job_replay(const MinerConfig* config, void (*publish)(void* ctx, Job* job), void* ctx) {
+    g_replay.config = config;
+    g_replay.publish = publish;
+    g_replay.ctx = ctx;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, replay_thread, NULL) != 0) {
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+bool pool_seed_base(const char* seed, uint8_t base_key[32]) {
+    secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+    if (!ctx) return false;
+
+    // SHA-256 of the seed, rehashed in the (negligible) case it isn't a valid key
+    bool ok = EVP_Digest(seed, strlen(seed), base_key, NULL, EVP_sha256(), NULL) == 1;
+    while (ok && !secp256k1_ec_seckey_verify(ctx, base_key)) {
+        ok = EVP_Digest(base_key, 32, base_key, NULL, EVP_sha256(), NULL) == 1;
+    }
+
+    secp256k1_context_destroy(ctx);
+    return ok;
+}
@@ -3,6 +3,8 @@
 #include <string.h>
 #include <curl/curl.h>
 #include "../include/miner.h"
+#include "../include/metrics.h"
+#include "../include/simd.h"
 
 // 报告函数，向服务器报告挖矿状态
 bool report_status(const MinerConfig* config, uint64_t hash_count, double total_mined, const uint8_t* best_hash) {
@@ -21,9 +23,7 @@ bool report_status(const MinerConfig* config, uint64_t hash_count, double total_
     
     // 将最佳哈希转换为十六进制字符串
     char best_hash_hex[65] = {0};
-    for (int i = 0; i < 32; i++) {
-        sprintf(best_hash_hex + i*2, "%02x", best_hash[i]);
-    }
+    hex_encode_simd(best_hash_hex, best_hash, 32);
     
     // 构建URL
     char url[2048];
@@ -51,6 +51,8 @@ bool report_status(const MinerConfig* config, uint64_t hash_count, double total_
     curl_easy_cleanup(curl);
     
     if (res != CURLE_OK) {
+        metrics_inc(&g_metrics.curl_errors);
+        metrics_inc(&g_metrics.report_failures);
         printf("%s[ERROR] Failed to report status: %s%s\n", 
             ANSI_COLOR_RED, curl_easy_strerror(res), ANSI_COLOR_RESET);
         return false;
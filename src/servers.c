@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../include/miner.h"
+#include "../include/metrics.h"
+#include "../include/servers.h"
+
+// Switch to a faster server only when it is clearly faster, so similar
+// mirrors don't flap
+#define SERVER_SWITCH_GAIN 1.25
+
+typedef struct {
+    const char* url;             // Interned, jobs and solutions keep pointers to it
+    bool healthy;
+    uint64_t latency_ns;         // 0 until the first successful request
+} JobServer;
+
+static JobServer g_servers[MAX_JOB_SERVERS];
+static int g_server_count = 0;
+static int g_current = 0;        // Index of the server jobs come from
+static pthread_mutex_t g_servers_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Every URL ever configured. Never freed, so a job or solution from before a
+// reload still names its server.
+#define MAX_INTERNED_URLS 64
+static char* g_interned[MAX_INTERNED_URLS];
+static int g_interned_count = 0;
+
+// NULL once the table is full
+static const char* intern_url(const char* url) {
+    for (int i = 0; i < g_interned_count; i++) {
+        if (strcmp(g_interned[i], url) == 0) {
+            return g_interned[i];
+        }
+    }
+    if (g_interned_count == MAX_INTERNED_URLS) {
+        return NULL;
+    }
+    char* copy = strdup(url);
+    if (copy) {
+        g_interned[g_interned_count++] = copy;
+    }
+    return copy;
+}
+
+int set_job_servers(const char* list) {
+    JobServer servers[MAX_JOB_SERVERS];
+    int count = 0;
+    char* copy = strdup(list);
+    if (!copy) return 0;
+
+    char* save = NULL;
+    for (char* url = strtok_r(copy, ",", &save); url && count < MAX_JOB_SERVERS; url = strtok_r(NULL, ",", &save)) {
+        while (isspace((unsigned char)*url)) url++;
+        char* end = url + strlen(url);
+        while (end > url && (isspace((unsigned char)end[-1]) || end[-1] == '/')) end--;
+        *end = '\0';
+        if (*url == '\0') continue;
+
+        servers[count].url = intern_url(url);
+        if (!servers[count].url) {
+            printf("%s[ERROR] More than %d distinct job server URLs since startup, restart to use %s%s\n",
+                ANSI_COLOR_RED, MAX_INTERNED_URLS, url, ANSI_COLOR_RESET);
+            free(copy);
+            return 0;
+        }
+        servers[count].healthy = true;
+        servers[count].latency_ns = 0;
+        count++;
+    }
+    free(copy);
+
+    if (count == 0) {
+        printf("%s[ERROR] No job server configured%s\n", ANSI_COLOR_RED, ANSI_COLOR_RESET);
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_servers_mutex);
+    const char* current = g_server_count > 0 ? g_servers[g_current].url : NULL;
+    int new_current = 0;
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < g_server_count; j++) {
+            if (g_servers[j].url == servers[i].url) {
+                servers[i] = g_servers[j];
+            }
+        }
+        if (servers[i].url == current) {
+            new_current = i;
+        }
+    }
+    memcpy(g_servers, servers, sizeof(servers));
+    g_server_count = count;
+    g_current = new_current;
+    pthread_mutex_unlock(&g_servers_mutex);
+
+    if (count > 1) {
+        printf("%s[INFO] %d job servers, preferring %s%s\n", ANSI_COLOR_BLUE, count, servers[0].url, ANSI_COLOR_RESET);
+    }
+    return count;
+}
+
+// Record the outcome of a request to url, with g_servers_mutex held
+static void record_result(const char* url, bool ok, uint64_t elapsed_ns) {
+    for (int i = 0; i < g_server_count; i++) {
+        JobServer* server = &g_servers[i];
+        if (server->url != url) continue;
+
+        if (ok) {
+            server->latency_ns = server->latency_ns ? (server->latency_ns * 3 + elapsed_ns) / 4 : elapsed_ns;
+        }
+        if (server->healthy != ok) {
+            printf("\n%s[%s] Job server %s is %s%s\n", ok ? ANSI_COLOR_GREEN : ANSI_COLOR_YELLOW,
+                ok ? "INFO" : "WARN", url, ok ? "back up" : "down", ANSI_COLOR_RESET);
+        }
+        server->healthy = ok;
+    }
+}
+
+// Move to the fastest healthy server, with g_servers_mutex held
+static void select_server(void) {
+    int best = -1;
+    for (int i = 0; i < g_server_count; i++) {
+        if (!g_servers[i].healthy) continue;
+        if (best < 0 || g_servers[i].latency_ns < g_servers[best].latency_ns) {
+            best = i;
+        }
+    }
+    if (best < 0 || best == g_current) return;
+
+    const JobServer* current = &g_servers[g_current];
+    if (current->healthy && g_servers[best].latency_ns * SERVER_SWITCH_GAIN >= current->latency_ns) {
+        return;
+    }
+    printf("\n%s[INFO] Switching job server to %s%s\n", ANSI_COLOR_BLUE, g_servers[best].url, ANSI_COLOR_RESET);
+    g_current = best;
+}
+
+// One request to url, recorded against its server
+static bool fetch_from(const char* url, Job* job) {
+    uint64_t start = metrics_now_ns();
+    bool ok = get_job(url, job);
+    uint64_t elapsed = metrics_now_ns() - start;
+
+    pthread_mutex_lock(&g_servers_mutex);
+    record_result(url, ok, elapsed);
+    pthread_mutex_unlock(&g_servers_mutex);
+
+    if (ok) {
+        job->server = url;
+    }
+    return ok;
+}
+
+bool fetch_job(Job* job) {
+    // Current server first, then healthy ones in order, then the rest
+    const char* order[MAX_JOB_SERVERS];
+    int count = 0;
+    pthread_mutex_lock(&g_servers_mutex);
+    if (g_server_count > 0) {
+        order[count++] = g_servers[g_current].url;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < g_server_count; i++) {
+            if (i != g_current && g_servers[i].healthy == (pass == 0)) {
+                order[count++] = g_servers[i].url;
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_servers_mutex);
+
+    for (int i = 0; i < count; i++) {
+        if (fetch_from(order[i], job)) {
+            if (i > 0) {
+                pthread_mutex_lock(&g_servers_mutex);
+                for (int j = 0; j < g_server_count; j++) {
+                    if (g_servers[j].url == order[i] && j != g_current) {
+                        printf("\n%s[INFO] Failing over to %s%s\n", ANSI_COLOR_YELLOW, order[i], ANSI_COLOR_RESET);
+                        g_current = j;
+                    }
+                }
+                pthread_mutex_unlock(&g_servers_mutex);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* current_job_server(void) {
+    pthread_mutex_lock(&g_servers_mutex);
+    const char* url = g_server_count > 0 ? g_servers[g_current].url : NULL;
+    pthread_mutex_unlock(&g_servers_mutex);
+    return url;
+}
+
+int job_server_status(JobServerStatus* status, int max) {
+    pthread_mutex_lock(&g_servers_mutex);
+    int count = g_server_count < max ? g_server_count : max;
+    for (int i = 0; i < count; i++) {
+        status[i].url = g_servers[i].url;
+        status[i].healthy = g_servers[i].healthy;
+        status[i].latency_ns = g_servers[i].latency_ns;
+        status[i].current = i == g_current;
+    }
+    pthread_mutex_unlock(&g_servers_mutex);
+    return count;
+}
+
+static void* health_thread(void* arg) {
+    int interval = (int)(intptr_t)arg;
+    static Job probe;  // Probe responses are only checked, never published
+
+    while (1) {
+        sleep(interval);
+
+        const char* urls[MAX_JOB_SERVERS];
+        pthread_mutex_lock(&g_servers_mutex);
+        int count = g_server_count;
+        for (int i = 0; i < count; i++) {
+            urls[i] = g_servers[i].url;
+        }
+        pthread_mutex_unlock(&g_servers_mutex);
+
+        // With a single server there is nothing to fail over to
+        if (count < 2) continue;
+
+        for (int i = 0; i < count; i++) {
+            fetch_from(urls[i], &probe);
+        }
+
+        pthread_mutex_lock(&g_servers_mutex);
+        select_server();
+        pthread_mutex_unlock(&g_servers_mutex);
+    }
+
+    return NULL;
+}
+
+bool start_server_health_checks(int interval) {
+    if (interval <= 0) {
+        return true;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, health_thread, (void*)(intptr_t)interval) != 0) {
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <string.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include "../include/sha256.h"
+#include "../include/simd.h"
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define EP1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t load_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// 64 rounds with K[t] + W[t] already folded together
+#ifdef __SHA__
+// SHA-NI consumes K + W directly, so precomputed schedules skip the message instructions
+static inline void sha256_rounds(uint32_t state[8], const uint32_t kw[64]) {
+    #ifdef __AVX__
+    // SHA-NI has no VEX encoding; clear dirty upper halves left by vectorized code
+    _mm256_zeroupper();
+    #endif
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);   // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                   // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);                                         // CDGH
+    __m128i abef = state0;
+    __m128i cdgh = state1;
+
+    for (int t = 0; t < 64; t += 4) {
+        __m128i msg = _mm_loadu_si128((const __m128i*)(kw + t));
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0E);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    }
+
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+    tmp = _mm_shuffle_epi32(state0, 0x1B);       // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);    // DCHG
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));  // DCBA
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));     // HGFE
+}
+#else
+static inline void sha256_rounds(uint32_t state[8], const uint32_t kw[64]) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int t = 0; t < 64; t++) {
+        uint32_t t1 = h + EP1(e) + CH(e, f, g) + kw[t];
+        uint32_t t2 = EP0(a) + MAJ(a, b, c);
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+#endif
+
+// Only the first output word. Word 0 is the new `a` of round 63, so the last
+// round skips the `e` update and the other seven output words are never formed.
+#ifdef __SHA__
+static inline uint32_t sha256_rounds_word0(const uint32_t state[8], const uint32_t kw[64]) {
+    // SHA-NI retires rounds in pairs, only the finalization can be skipped
+    uint32_t out[8];
+    memcpy(out, state, sizeof(out));
+    sha256_rounds(out, kw);
+    return out[0];
+}
+#else
+static inline uint32_t sha256_rounds_word0(const uint32_t state[8], const uint32_t kw[64]) {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int t = 0; t < 63; t++) {
+        uint32_t t1 = h + EP1(e) + CH(e, f, g) + kw[t];
+        uint32_t t2 = EP0(a) + MAJ(a, b, c);
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    uint32_t t1 = h + EP1(e) + CH(e, f, g) + kw[63];
+    return state[0] + t1 + EP0(a) + MAJ(a, b, c);
+}
+#endif
+
+static void expand_schedule(const uint32_t w_in[16], uint32_t kw[64]) {
+    uint32_t w[64];
+    memcpy(w, w_in, 16 * sizeof(uint32_t));
+    for (int t = 0; t < 16; t++) {
+        kw[t] = K[t] + w[t];
+    }
+    for (int t = 16; t < 64; t++) {
+        w[t] = SIG1(w[t - 2]) + w[t - 7] + SIG0(w[t - 15]) + w[t - 16];
+        kw[t] = K[t] + w[t];
+    }
+}
+
+void sha256_init_state(uint32_t state[8]) {
+    memcpy(state, IV, sizeof(IV));
+}
+
+void sha256_transform(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[16];
+    uint32_t kw[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = load_be32(block + i * 4);
+    }
+    expand_schedule(w, kw);
+    sha256_rounds(state, kw);
+}
+
+void sha256_state_to_bytes(const uint32_t state[8], uint8_t out[32]) {
+    for (int i = 0; i < 8; i++) {
+        out[i * 4] = (uint8_t)(state[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)state[i];
+    }
+}
+
+void sha256_pubkey_midstate(uint32_t midstate[8], const uint8_t public_key[65]) {
+    char hex[SHA256_PREFIX_LEN];
+    hex_encode_simd(hex, public_key, SHA256_PREFIX_LEN / 2);
+    sha256_init_state(midstate);
+    sha256_transform(midstate, (const uint8_t*)hex);
+    sha256_transform(midstate, (const uint8_t*)hex + 64);
+}
+
+bool sha256_build_tail(Sha256TailTemplate* tail, const char* seed, size_t seed_len) {
+    if (seed_len > MAX_SEED_LEN) {
+        return false;
+    }
+
+    // Lay out the tail bytes: 2 candidate chars (zero here), seed, 0x80, zeros, bit length
+    uint8_t bytes[SHA256_MAX_TAIL_BLOCKS * 64] = {0};
+    size_t tail_len = 2 + seed_len;
+    memcpy(bytes + 2, seed, seed_len);
+    bytes[tail_len] = 0x80;
+    int blocks = (int)((tail_len + 9 + 63) / 64);
+    uint64_t bit_len = (uint64_t)(SHA256_PREFIX_LEN + tail_len) * 8;
+    for (int i = 0; i < 8; i++) {
+        bytes[blocks * 64 - 1 - i] = (uint8_t)(bit_len >> (i * 8));
+    }
+
+    memset(tail, 0, sizeof(*tail));
+    tail->blocks = blocks;
+
+    // First block: word 0 carries the candidate chars in its top 16 bits
+    uint32_t* w = tail->w_first;
+    for (int i = 0; i < 16; i++) {
+        w[i] = load_be32(bytes + i * 4);
+    }
+    tail->w0_low = w[0] & 0xFFFF;
+    for (int t = 1; t < 16; t++) {
+        tail->kw_first[t] = K[t] + w[t];
+    }
+
+    // Fold every schedule term that only reads w[1..15] into w_pre. Terms
+    // reading w[0] or any expanded word are added per candidate.
+    for (int t = 16; t < 32; t++) {
+        uint32_t pre = 0;
+        if (t - 2 < 16) pre += SIG1(w[t - 2]);
+        if (t - 7 < 16) pre += w[t - 7];
+        if (t - 15 < 16) pre += SIG0(w[t - 15]);
+        if (t - 16 >= 1 && t - 16 < 16) pre += w[t - 16];
+        tail->w_pre[t] = pre;
+    }
+
+    // Later blocks don't depend on the candidate at all
+    for (int b = 1; b < blocks; b++) {
+        uint32_t wb[16];
+        for (int i = 0; i < 16; i++) {
+            wb[i] = load_be32(bytes + b * 64 + i * 4);
+        }
+        expand_schedule(wb, tail->kw_rest[b - 1]);
+    }
+
+    return true;
+}
+
+// K + W of the first tail block for one candidate
+static inline void first_block_schedule(const Sha256TailTemplate* tail, uint8_t last_pubkey_byte,
+                                        uint32_t kw[64]) {
+    static const char digits[16] = "0123456789abcdef";
+    uint32_t w[64];
+
+    memcpy(w, tail->w_first, sizeof(tail->w_first));
+    w[0] = ((uint32_t)digits[last_pubkey_byte >> 4] << 24) |
+           ((uint32_t)digits[last_pubkey_byte & 0x0F] << 16) | tail->w0_low;
+
+    kw[0] = K[0] + w[0];
+    memcpy(kw + 1, tail->kw_first + 1, 15 * sizeof(uint32_t));
+
+    // Only the terms that touch w[0] or expanded words are left to compute.
+    // K is folded in as each word is produced.
+    w[16] = tail->w_pre[16] + w[0];
+    w[17] = tail->w_pre[17];
+    kw[16] = K[16] + w[16];
+    kw[17] = K[17] + w[17];
+    for (int t = 18; t < 23; t++) {
+        w[t] = tail->w_pre[t] + SIG1(w[t - 2]);
+        kw[t] = K[t] + w[t];
+    }
+    for (int t = 23; t < 31; t++) {
+        w[t] = tail->w_pre[t] + SIG1(w[t - 2]) + w[t - 7];
+        kw[t] = K[t] + w[t];
+    }
+    w[31] = tail->w_pre[31] + SIG1(w[29]) + w[24] + SIG0(w[16]);
+    kw[31] = K[31] + w[31];
+    for (int t = 32; t < 64; t++) {
+        w[t] = SIG1(w[t - 2]) + w[t - 7] + SIG0(w[t - 15]) + w[t - 16];
+        kw[t] = K[t] + w[t];
+    }
+
+}
+
+void sha256_tail_final(const Sha256TailTemplate* tail, const uint32_t midstate[8],
+                       uint8_t last_pubkey_byte, uint32_t digest[8]) {
+    uint32_t kw[64];
+    first_block_schedule(tail, last_pubkey_byte, kw);
+
+    memcpy(digest, midstate, 8 * sizeof(uint32_t));
+    sha256_rounds(digest, kw);
+    for (int b = 1; b < tail->blocks; b++) {
+        sha256_rounds(digest, tail->kw_rest[b - 1]);
+    }
+}
+
+uint32_t sha256_tail_word0(const Sha256TailTemplate* tail, const uint32_t midstate[8],
+                           uint8_t last_pubkey_byte) {
+    uint32_t kw[64];
+    uint32_t state[8];
+    first_block_schedule(tail, last_pubkey_byte, kw);
+
+    if (tail->blocks == 1) {
+        return sha256_rounds_word0(midstate, kw);
+    }
+    memcpy(state, midstate, sizeof(state));
+    sha256_rounds(state, kw);
+    for (int b = 1; b < tail->blocks - 1; b++) {
+        sha256_rounds(state, tail->kw_rest[b - 1]);
+    }
+    return sha256_rounds_word0(state, tail->kw_rest[tail->blocks - 2]);
+}
+
+bool sha256_self_test(void) {
+    static const char digits[16] = "0123456789abcdef";
+    uint8_t public_key[65];
+    char seed[MAX_SEED_LEN + 1];
+    char message[SHA256_PREFIX_LEN + 2 + MAX_SEED_LEN];
+    uint8_t expected[32];
+    uint8_t actual[32];
+    Sha256TailTemplate tail;
+
+    for (size_t seed_len = 0; seed_len <= MAX_SEED_LEN; seed_len++) {
+        if (RAND_bytes(public_key, sizeof(public_key)) != 1 ||
+            RAND_bytes((uint8_t*)seed, (int)seed_len) != 1) {
+            return false;
+        }
+        for (size_t i = 0; i < seed_len; i++) {
+            seed[i] = digits[seed[i] & 0x0F];
+        }
+
+        hex_encode_simd(message, public_key, 65);
+        memcpy(message + 130, seed, seed_len);
+        if (EVP_Digest(message, 130 + seed_len, expected, NULL, EVP_sha256(), NULL) != 1) {
+            return false;
+        }
+
+        uint32_t midstate[8];
+        uint32_t digest[8];
+        sha256_pubkey_midstate(midstate, public_key);
+        if (!sha256_build_tail(&tail, seed, seed_len)) {
+            return false;
+        }
+        sha256_tail_final(&tail, midstate, public_key[64], digest);
+        sha256_state_to_bytes(digest, actual);
+
+        if (memcmp(expected, actual, 32) != 0 ||
+            sha256_tail_word0(&tail, midstate, public_key[64]) != digest[0]) {
+            printf("SHA-256 self test failed for seed length %zu\n", seed_len);
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include "../include/miner.h"
+
+// Fill a sockaddr_un for "unix:/path" style addresses
+static bool unix_address(const char* path, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        printf("%s[ERROR] Socket path too long: %s%s\n", ANSI_COLOR_RED, path, ANSI_COLOR_RESET);
+        return false;
+    }
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+// Resolve "host:port"; an empty host means any address when listening
+static struct addrinfo* tcp_address(const char* address, bool passive) {
+    char host[256];
+    const char* colon = strrchr(address, ':');
+    if (!colon || (size_t)(colon - address) >= sizeof(host)) {
+        printf("%s[ERROR] Invalid address: %s%s\n", ANSI_COLOR_RED, address, ANSI_COLOR_RESET);
+        return NULL;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+
+    struct addrinfo hints = {0};
+    struct addrinfo* res = NULL;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res) != 0) {
+        printf("%s[ERROR] Cannot resolve address: %s%s\n", ANSI_COLOR_RED, address, ANSI_COLOR_RESET);
+        return NULL;
+    }
+    return res;
+}
+
+int open_listener(const char* address) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        if (!unix_address(address + 5, &addr)) return -1;
+        unlink(addr.sun_path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    struct addrinfo* res = tcp_address(address, true);
+    if (!res) return -1;
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, res->ai_addr, res->ai_addrlen) != 0 || listen(fd, 64) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int connect_socket(const char* address) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un addr;
+        if (!unix_address(address + 5, &addr)) return -1;
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    struct addrinfo* res = tcp_address(address, false);
+    if (!res) return -1;
+
+    int fd = -1;
+    for (struct addrinfo* ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+bool send_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
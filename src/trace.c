@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include "../include/miner.h"
+#include "../include/trace.h"
+
+#ifdef CMINER_TRACE
+
+#define TRACE_RING_SIZE (1 << 14)   // Samples kept per thread, must be a power of two
+#define TRACE_MAX_RINGS (MAX_THREADS + 8)
+
+typedef struct {
+    uint64_t start;
+    uint32_t cycles;
+    uint32_t event;
+} TraceSample;
+
+// Single-producer ring owned by one thread. The dumper only reads, and
+// drops samples that were overwritten while it was copying.
+typedef struct {
+    _Atomic uint64_t head;
+    int tid;
+    TraceSample samples[TRACE_RING_SIZE];
+} TraceRing;
+
+static const char* event_names[TRACE_EVENT_COUNT] = {
+    "job_check", "pool_fetch", "hash", "compare", "submit"
+};
+
+static TraceRing* g_rings[TRACE_MAX_RINGS];
+static _Atomic int g_ring_count = 0;
+static __thread TraceRing* t_ring = NULL;
+
+// TSC/clock reference pair taken at startup, used to convert cycles to time
+static uint64_t g_tsc_base;
+static uint64_t g_ns_base;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void trace_init(void) {
+    g_tsc_base = __rdtsc();
+    g_ns_base = now_ns();
+    printf("%s[INFO] Tracing enabled, send SIGUSR2 to dump%s\n", ANSI_COLOR_BLUE, ANSI_COLOR_RESET);
+}
+
+static TraceRing* register_ring(void) {
+    int slot = atomic_fetch_add(&g_ring_count, 1);
+    if (slot >= TRACE_MAX_RINGS) {
+        return NULL;
+    }
+    TraceRing* ring = calloc(1, sizeof(TraceRing));
+    if (!ring) {
+        return NULL;
+    }
+    ring->tid = slot;
+    g_rings[slot] = ring;
+    return ring;
+}
+
+void trace_record(TraceEvent event, uint64_t start, uint64_t end) {
+    TraceRing* ring = t_ring;
+    if (!ring) {
+        ring = t_ring = register_ring();
+        if (!ring) return;
+    }
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceSample* sample = &ring->samples[head & (TRACE_RING_SIZE - 1)];
+    uint64_t cycles = end - start;
+    sample->start = start;
+    sample->cycles = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t)cycles;
+    sample->event = event;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+bool trace_dump(const char* path) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        printf("%s[ERROR] Failed to open trace file %s%s\n", ANSI_COLOR_RED, path, ANSI_COLOR_RESET);
+        return false;
+    }
+
+    // Calibrate against the clock now so long runs get an accurate rate
+    double cycles_per_us = (double)(__rdtsc() - g_tsc_base) / ((now_ns() - g_ns_base) / 1000.0);
+    int pid = getpid();
+    int ring_count = atomic_load(&g_ring_count);
+    if (ring_count > TRACE_MAX_RINGS) ring_count = TRACE_MAX_RINGS;
+
+    TraceSample* copy = malloc(sizeof(TraceSample) * TRACE_RING_SIZE);
+    if (!copy) {
+        fclose(fp);
+        return false;
+    }
+
+    size_t written = 0;
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int r = 0; r < ring_count; r++) {
+        TraceRing* ring = g_rings[r];
+        if (!ring) continue;
+
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for (uint64_t i = first; i < head; i++) {
+            copy[i - first] = ring->samples[i & (TRACE_RING_SIZE - 1)];
+        }
+        // Anything the producer lapped while we copied is torn, skip it. It
+        // may also be writing sample `after` right now, which reuses the slot
+        // of sample after - TRACE_RING_SIZE.
+        uint64_t after = atomic_load_explicit(&ring->head, memory_order_acquire);
+        uint64_t valid = after >= TRACE_RING_SIZE ? after - TRACE_RING_SIZE + 1 : 0;
+        if (valid < first) valid = first;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                written ? ",\n" : "", pid, ring->tid, ring->tid);
+        written++;
+
+        for (uint64_t i = valid; i < head; i++) {
+            const TraceSample* s = &copy[i - first];
+            if (s->event >= TRACE_EVENT_COUNT) continue;
+            double ts = (double)(int64_t)(s->start - g_tsc_base) / cycles_per_us;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    event_names[s->event], pid, ring->tid, ts, s->cycles / cycles_per_us);
+            written++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    free(copy);
+    fclose(fp);
+    printf("%s[INFO] Wrote %zu trace events to %s%s\n", ANSI_COLOR_BLUE, written, path, ANSI_COLOR_RESET);
+    return true;
+}
+
+#else
+
+void trace_init(void) {
+}
+
+bool trace_dump(const char* path) {
+    (void)path;
+    printf("%s[WARN] Tracing is not compiled in, rebuild with make TRACE=1%s\n", ANSI_COLOR_YELLOW, ANSI_COLOR_RESET);
+    return false;
+}
+
+#endif // CMINER_TRACE
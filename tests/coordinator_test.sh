@@ -0,0 +1,153 @@
+#!/bin/sh
+# Coordinator mode with several local processes:
+#
+#   tests/coordinator_test.sh [path/to/cminer]
+#
+# Starts a stub pool server, a coordinator and two workers on a Unix socket,
+# each in its own directory under a temporary root, and checks that
+#   - every worker is assigned a range and no two ranges share a base
+#   - solutions relayed by the workers are valid and accepted by the pool
+#   - a HELLO claiming a range that another worker holds gets a new range
+#   - workers reconnecting to a restarted coordinator, which didn't hand out
+#     their ranges, are moved to new ones and keep relaying solutions
+# Needs python3 for the stub pool and the raw protocol client.
+set -u
+
+CMINER=$(realpath "${1:-./cminer}")
+ROOT=$(mktemp -d /tmp/cminer-coord.XXXXXX)
+PORT=$((20000 + $$ % 20000))
+SOCKET="$ROOT/coordinator.sock"
+# Roughly one pool key in 256 solves a job
+DIFF=00ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff
+PIDS=""
+FAILED=0
+
+cleanup() {
+    for pid in $PIDS; do kill "$pid" 2>/dev/null; done
+    wait 2>/dev/null
+    if [ "$FAILED" -eq 0 ]; then rm -rf "$ROOT"; else echo "Logs kept in $ROOT"; fi
+}
+trap cleanup EXIT INT TERM
+
+check() {
+    if eval "$2"; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1"
+        FAILED=1
+    fi
+}
+
+# Serves one fixed job and validates submissions like the real server
+cat > "$ROOT/pool.py" <<PY
+import hashlib, http.server, json, sys, time
+from urllib.parse import urlparse, parse_qs
+seed, diff = "coordinator-test", "$DIFF"
+class Pool(http.server.BaseHTTPRequestHandler):
+    def log_message(self, *args): pass
+    def do_GET(self):
+        url = urlparse(self.path)
+        if url.path == "/get-challenge":
+            body = json.dumps({"seed": seed, "diff": diff, "reward": 1.0, "lastFound": int(time.time() * 1000)})
+        elif url.path == "/challenge-solved":
+            query = parse_qs(url.query)
+            digest = hashlib.sha256((query["holder"][0] + seed).encode()).hexdigest()
+            ok = digest == query["hash"][0] and digest <= diff
+            print("SOLVED", ok, digest, flush=True)
+            body = "success" if ok else "bad"
+        else:
+            body = "ok"
+        self.send_response(200)
+        self.end_headers()
+        self.wfile.write(body.encode())
+http.server.ThreadingHTTPServer(("127.0.0.1", $PORT), Pool).serve_forever()
+PY
+
+write_config() {
+    mkdir -p "$ROOT/$1/rewards"
+    cat > "$ROOT/$1/cminer.conf" <<CONF
+server = "http://127.0.0.1:$PORT"
+rewards_dir = "./rewards"
+thread = 1
+job_interval = 1
+report_interval = 1000
+pool_memory = "512K"
+generator_threads = 1
+$2
+CONF
+}
+
+start() {
+    (cd "$ROOT/$1" && exec "$CMINER" >> out.log 2>&1) &
+    eval "PID_$1=$!"
+    PIDS="$PIDS $!"
+}
+
+# Base of the last range a worker was assigned
+range_of() {
+    grep -o 'Assigned keyspace range [0-9a-f]*' "$ROOT/$1/out.log" | tail -n 1 | cut -d' ' -f4
+}
+
+count_of() {
+    grep -c "$2" "$ROOT/$1/out.log"
+}
+
+python3 "$ROOT/pool.py" > "$ROOT/pool.log" 2>&1 &
+PIDS="$PIDS $!"
+write_config coordinator "coordinator_listen = \"unix:$SOCKET\""
+write_config worker1 "coordinator = \"unix:$SOCKET\"
+worker_name = \"worker1\""
+write_config worker2 "coordinator = \"unix:$SOCKET\"
+worker_name = \"worker2\""
+
+start coordinator
+sleep 2
+start worker1
+start worker2
+sleep 15
+
+BASE1=$(range_of worker1)
+BASE2=$(range_of worker2)
+check "workers were assigned ranges" '[ -n "$BASE1" ] && [ -n "$BASE2" ]'
+check "worker ranges are disjoint" '[ "$BASE1" != "$BASE2" ]'
+check "workers relayed accepted solutions" \
+    '[ "$(count_of worker1 "Coordinator submitted")" -gt 0 ] && [ "$(count_of worker2 "Coordinator submitted")" -gt 0 ]'
+
+# A second client claiming worker1's range while worker1 still holds it
+python3 - "$SOCKET" "$BASE1" > "$ROOT/intruder.log" 2>&1 <<'PY'
+import socket, sys
+sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+sock.settimeout(5)
+sock.connect(sys.argv[1])
+sock.sendall(("HELLO intruder 1024 %s\n" % sys.argv[2]).encode())
+reply = b""
+while b"RANGE" not in reply or not reply.endswith(b"\n"):
+    chunk = sock.recv(4096)
+    if not chunk:
+        break
+    reply += chunk
+for line in reply.decode().splitlines():
+    if line.startswith("RANGE "):
+        print(line.split()[1])
+PY
+INTRUDER=$(grep -v '^$' "$ROOT/intruder.log" | tail -n 1)
+check "a claimed range held by another worker is not handed over" \
+    '[ -n "$INTRUDER" ] && [ "$INTRUDER" != "$BASE1" ] && [ "$INTRUDER" != "$BASE2" ]'
+
+# A restarted coordinator has a new master key and knows none of the ranges
+kill "$PID_coordinator"
+sleep 1
+SUBMITTED1=$(count_of worker1 "Coordinator submitted")
+start coordinator
+sleep 20
+
+NEW1=$(range_of worker1)
+NEW2=$(range_of worker2)
+check "workers got new ranges from the restarted coordinator" \
+    '[ "$NEW1" != "$BASE1" ] && [ "$NEW2" != "$BASE2" ] && [ "$NEW1" != "$NEW2" ]'
+check "workers keep relaying after the restart" \
+    '[ "$(count_of worker1 "Coordinator submitted")" -gt "$SUBMITTED1" ]'
+check "every submitted solution was valid" \
+    '[ "$(grep -c "SOLVED True" "$ROOT/pool.log")" -gt 0 ] && ! grep -q "SOLVED False" "$ROOT/pool.log"'
+
+exit "$FAILED"
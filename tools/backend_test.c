@@ -0,0 +1,25 @@
+// Check an OpenCL device against the CPU reference backend, the same check
+// the miner runs at startup.
+//
+//   backend_test [platform:device]
+//
+// make OPENCL=1 backend-test builds and runs it on OPENCL_DEVICE (0:0 by
+// default). On hosts without a GPU the POCL CPU driver provides the device.
+#include <stdio.h>
+#include "../include/backend.h"
+
+// Pool capacity the device buffers are sized for
+#define TEST_CAPACITY (1 << 16)
+
+int main(int argc, char** argv) {
+    const char* device = argc > 1 ? argv[1] : "0:0";
+
+    ComputeBackend* backend = create_opencl_backend(device, TEST_CAPACITY);
+    if (!backend) {
+        fprintf(stderr, "No OpenCL device %s\n", device);
+        return 1;
+    }
+    bool ok = backend_self_test(backend, TEST_CAPACITY);
+    backend->destroy(backend);
+    return ok ? 0 : 1;
+}
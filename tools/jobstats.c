@@ -0,0 +1,247 @@
+// Summarize cminer job logs (job_log) per day or per node.
+//
+//   jobstats [-n] [-d days] file...
+//
+// -n groups by node instead of by UTC day, -d only counts jobs that started in
+// the last days. Luck is solutions found over solutions expected from the
+// distinct candidates hashed: 100% is exactly as lucky as the difficulty
+// implies. Efficiency is the share of hashes that went to distinct candidates,
+// hashing past the pool size of a job only repeats candidates.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LINE_SIZE 1024
+#define LOG_COLUMNS 12
+// Nodes this far below the median node hash rate are flagged
+#define SLOW_NODE_RATIO 0.8
+
+typedef struct {
+    char key[64];
+    uint64_t jobs;
+    double seconds;
+    uint64_t hashes;
+    uint64_t candidates;
+    double expected_found;  // Sum of candidates / expected_hashes over the jobs
+    uint64_t found;
+    double reward;
+} Group;
+
+static Group* g_groups = NULL;
+static size_t g_group_count = 0;
+static size_t g_group_capacity = 0;
+
+static Group* find_group(const char* key) {
+    for (size_t i = 0; i < g_group_count; i++) {
+        if (strcmp(g_groups[i].key, key) == 0) {
+            return &g_groups[i];
+        }
+    }
+    if (g_group_count == g_group_capacity) {
+        size_t capacity = g_group_capacity ? g_group_capacity * 2 : 64;
+        Group* groups = realloc(g_groups, capacity * sizeof(Group));
+        if (!groups) {
+            return NULL;
+        }
+        g_groups = groups;
+        g_group_capacity = capacity;
+    }
+    Group* group = &g_groups[g_group_count++];
+    memset(group, 0, sizeof(*group));
+    snprintf(group->key, sizeof(group->key), "%s", key);
+    return group;
+}
+
+static int compare_groups(const void* a, const void* b) {
+    return strcmp(((const Group*)a)->key, ((const Group*)b)->key);
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Split a log line into its columns in place. The seed is last and may hold
+// commas, so only the first LOG_COLUMNS - 1 commas split.
+static bool split_line(char* line, char* columns[LOG_COLUMNS]) {
+    line[strcspn(line, "\r\n")] = '\0';
+    columns[0] = line;
+    for (int i = 1; i < LOG_COLUMNS; i++) {
+        char* comma = strchr(columns[i - 1], ',');
+        if (!comma) {
+            return false;
+        }
+        *comma = '\0';
+        columns[i] = comma + 1;
+    }
+    return true;
+}
+
+static bool read_log(const char* path, bool by_node, time_t since) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+
+    char line[LINE_SIZE];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        if (strncmp(line, "start,", 6) == 0) continue;
+
+        // start,seconds,hashes,candidates,hash_rate,expected_hashes,found,reward,best_hash,diff,node,seed
+        char* columns[LOG_COLUMNS];
+        if (!split_line(line, columns)) {
+            fprintf(stderr, "%s:%d: malformed line\n", path, line_no);
+            continue;
+        }
+        time_t start = (time_t)strtoll(columns[0], NULL, 10);
+        double seconds = strtod(columns[1], NULL);
+        uint64_t hashes = strtoull(columns[2], NULL, 10);
+        uint64_t candidates = strtoull(columns[3], NULL, 10);
+        // Up to 78 digits, a double keeps far more precision than luck needs
+        double expected = strtod(columns[5], NULL);
+        uint64_t found = strtoull(columns[6], NULL, 10);
+        double reward = strtod(columns[7], NULL);
+        if (start < since || expected <= 0) continue;
+
+        char key[64];
+        if (by_node) {
+            snprintf(key, sizeof(key), "%s", columns[10]);
+        } else {
+            struct tm day;
+            gmtime_r(&start, &day);
+            strftime(key, sizeof(key), "%Y-%m-%d", &day);
+        }
+        Group* group = find_group(key);
+        if (!group) {
+            fclose(fp);
+            return false;
+        }
+        group->jobs++;
+        group->seconds += seconds;
+        group->hashes += hashes;
+        group->candidates += candidates;
+        group->expected_found += candidates / expected;
+        group->found += found;
+        group->reward += reward;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+static void print_rate(double rate) {
+    if (rate >= 1e9) {
+        printf(" %8.2f GH/s", rate / 1e9);
+    } else if (rate >= 1e6) {
+        printf(" %8.2f MH/s", rate / 1e6);
+    } else {
+        printf(" %8.2f KH/s", rate / 1e3);
+    }
+}
+
+static void print_group(const Group* group, double median_rate) {
+    double rate = group->seconds > 0 ? group->hashes / group->seconds : 0;
+    printf("%-24s %6" PRIu64 " %8.1f %20" PRIu64, group->key, group->jobs, group->seconds / 3600, group->hashes);
+    print_rate(rate);
+    printf(" %6.1f%%", group->hashes ? 100.0 * group->candidates / group->hashes : 0.0);
+    printf(" %10.3f %6" PRIu64, group->expected_found, group->found);
+    if (group->expected_found > 0) {
+        printf(" %7.1f%%", 100.0 * group->found / group->expected_found);
+    } else {
+        printf(" %8s", "-");
+    }
+    printf(" %12.2f", group->reward);
+    if (median_rate > 0 && rate < median_rate * SLOW_NODE_RATIO) {
+        printf("  SLOW (%.0f%% of median)", 100.0 * rate / median_rate);
+    }
+    printf("\n");
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-n] [-d days] job_log.csv...\n", name);
+    fprintf(stderr, "  -n       group by node instead of by UTC day\n");
+    fprintf(stderr, "  -d days  only jobs started in the last days\n");
+}
+
+int main(int argc, char** argv) {
+    bool by_node = false;
+    time_t since = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "nd:")) != -1) {
+        switch (opt) {
+            case 'n':
+                by_node = true;
+                break;
+            case 'd':
+                since = time(NULL) - (time_t)(atof(optarg) * 86400);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (!read_log(argv[i], by_node, since)) {
+            return 1;
+        }
+    }
+    if (g_group_count == 0) {
+        printf("No jobs\n");
+        return 0;
+    }
+    qsort(g_groups, g_group_count, sizeof(Group), compare_groups);
+
+    // Slow nodes are only told apart from the fleet's median node
+    double median_rate = 0;
+    if (by_node && g_group_count > 1) {
+        double* rates = malloc(g_group_count * sizeof(double));
+        if (rates) {
+            for (size_t i = 0; i < g_group_count; i++) {
+                rates[i] = g_groups[i].seconds > 0 ? g_groups[i].hashes / g_groups[i].seconds : 0;
+            }
+            qsort(rates, g_group_count, sizeof(double), compare_doubles);
+            median_rate = g_group_count % 2 ? rates[g_group_count / 2]
+                : (rates[g_group_count / 2 - 1] + rates[g_group_count / 2]) / 2;
+            free(rates);
+        }
+    }
+
+    Group total = {0};
+    snprintf(total.key, sizeof(total.key), "total");
+    printf("%-24s %6s %8s %20s %13s %7s %10s %6s %8s %12s\n",
+        by_node ? "node" : "day", "jobs", "hours", "hashes", "hash rate", "effic", "expected", "found", "luck", "reward");
+    for (size_t i = 0; i < g_group_count; i++) {
+        print_group(&g_groups[i], median_rate);
+        total.jobs += g_groups[i].jobs;
+        total.hashes += g_groups[i].hashes;
+        total.candidates += g_groups[i].candidates;
+        total.expected_found += g_groups[i].expected_found;
+        total.found += g_groups[i].found;
+        total.reward += g_groups[i].reward;
+        // Nodes mine side by side, days one after another
+        if (by_node) {
+            total.seconds = total.seconds > g_groups[i].seconds ? total.seconds : g_groups[i].seconds;
+        } else {
+            total.seconds += g_groups[i].seconds;
+        }
+    }
+    print_group(&total, 0);
+
+    free(g_groups);
+    return 0;
+}